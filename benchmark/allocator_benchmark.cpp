@@ -0,0 +1,81 @@
+//
+//  allocator_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Same variables and functions as in tests
+static const char* createVariables = R"(
+integer = 10
+number = 2.5
+text = "hello"
+table = { 100, 'hello', true, a = 'a', b = 'b', c = 'c', one = 1, two = 2, three = 3 }
+nested = { ["table"] = table }
+nested.nested = nested
+function getNested() nested.func = getNested return nested end
+function getValues() return 1, 2, 3 end
+function pack(...) return {...} end
+)";
+
+static const char* churnScript = R"(
+local items = {}
+for i = 1, 200 do
+    items[i] = { index = i, name = 'item' .. i, values = pack(i, i + 1, i + 2) }
+end
+local closures = {}
+for i = 1, 100 do
+    closures[i] = function() return items[i].name end
+end
+return #items
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void runWorkloads(const char* name, const lua::StateOptions& options, long count)
+{
+    printf("%s\n", name);
+    
+    measure("  create state + test variables", count, [&options]() {
+        lua::State state(options);
+        state.doString(createVariables);
+    });
+    
+    lua::State state(options);
+    state.doString(createVariables);
+    
+    measure("  table queries", count * 20, [&state]() {
+        int one = state["nested"]["nested"]["table"]["one"];
+        (void)one;
+    });
+    
+    measure("  function calls", count * 20, [&state]() {
+        int value = state["getValues"]();
+        (void)value;
+    });
+    
+    state.set("add", [](int a, int b) { return a + b; });
+    measure("  lambda calls from Lua", count, [&state]() {
+        state.doString("local sum = 0 for i = 1, 10 do sum = add(sum, i) end");
+    });
+    
+    measure("  tables, strings and closures churn", count / 10, [&state]() {
+        int items = state.doString(churnScript);
+        (void)items;
+    });
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 10000);
+    
+    runWorkloads("default allocator", lua::StateOptions(), count);
+    
+    lua::StateOptions options;
+    options.poolAllocator = true;
+    runWorkloads("pool allocator", options, count);
+    
+    return 0;
+}
@@ -0,0 +1,66 @@
+//
+//  arena_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Request scoped sandbox script
+static const char* requestScript = R"(
+local response = {}
+for i = 1, 500 do
+    response[i] = { id = i, name = 'item' .. i, tags = { 'a', 'b' } }
+end
+return #response
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void benchmarkCycles(const char* name, const lua::StateOptions& options, long count)
+{
+    measure(name, count, [&options]() {
+        lua::State state(options);
+        int items = state.doString(requestScript);
+        (void)items;
+    });
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 5000);
+    unsigned libraries = lua::lib::Base | lua::lib::String | lua::lib::Table;
+    
+    printf("create-run-destroy cycles\n");
+    
+    lua::StateOptions options(libraries);
+    benchmarkCycles("  default allocator", options, count);
+    
+    options.poolAllocator = true;
+    benchmarkCycles("  pool allocator", options, count);
+    
+    options.poolAllocator = false;
+    options.arenaAllocator = true;
+    benchmarkCycles("  arena allocator", options, count);
+    
+    options.fastTeardown = true;
+    benchmarkCycles("  arena allocator, fast teardown", options, count);
+    
+    // Arena is reused, so no memory is allocated from system
+    lua::ArenaAllocator allocator(4 * 1024 * 1024);
+    options.arenaAllocator = false;
+    options.allocator = &lua::ArenaAllocator::allocate;
+    options.allocatorData = &allocator;
+    
+    measure("  reused arena, fast teardown", count, [&options, &allocator]() {
+        {
+            lua::State state(options);
+            int items = state.doString(requestScript);
+            (void)items;
+        }
+        allocator.reset();
+    });
+    
+    return 0;
+}
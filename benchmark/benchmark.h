@@ -0,0 +1,40 @@
+//
+//  benchmark.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "../include/LuaState.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Measures seconds of running given function for given iterations and prints results
+template <typename Function>
+double measure(const char* name, long iterations, Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i)
+        function();
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-40s %12.0f ops/s %12.3f us/op\n", name, iterations / seconds, seconds * 1e6 / iterations);
+    return seconds;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Number of iterations can be scaled with first program argument
+inline long iterations(int argc, char** argv, long defaultIterations)
+{
+    return argc > 1 ? static_cast<long>(defaultIterations * atof(argv[1])) : defaultIterations;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// @return Bytes used by Lua state
+inline size_t memoryUsage(lua::State& state)
+{
+    lua_State* luaState = state.getState();
+    return static_cast<size_t>(lua_gc(luaState, LUA_GCCOUNT, 0)) * 1024 + lua_gc(luaState, LUA_GCCOUNTB, 0);
+}
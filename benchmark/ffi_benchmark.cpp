@@ -0,0 +1,53 @@
+//
+//  ffi_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+#include "../include/LuaFFI.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static double damp(double value, double factor)
+{
+    return value * factor;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Hot loop calling bound function, JIT compiler can keep it in trace only when function is FFI pointer
+static const char* createLoop = R"(
+function loop(callee, calls)
+    local sum = 0
+    for i = 1, calls do
+        sum = sum + callee(i, 0.5)
+    end
+    return sum
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long calls = iterations(argc, argv, 1000000);
+    long repeats = 10;
+
+    lua::State state;
+    state.doString(createLoop);
+    state.set("calls", static_cast<int>(calls));
+
+    state.set("functorDamp", &damp);
+    bool ffi = lua::setFFIFunction(state, "ffiDamp", &damp);
+    printf("%ld calls per loop, FFI is %s\n", calls, ffi ? "used" : "not available");
+
+    double seconds = measure("Functor calls in loop", repeats, [&]() {
+        state.doString("return loop(functorDamp, calls)");
+    });
+    printf("%-40s %12.1f Mcalls/s\n", "", calls * repeats / seconds / 1e6);
+
+    seconds = measure("setFFIFunction calls in loop", repeats, [&]() {
+        state.doString("return loop(ffiDamp, calls)");
+    });
+    printf("%-40s %12.1f Mcalls/s\n", "", calls * repeats / seconds / 1e6);
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+//
+//  iteration_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long entries = iterations(argc, argv, 100000);
+    long repeats = 20;
+
+    lua::State state;
+    state.set("entries", static_cast<int>(entries));
+    state.doString("config = {} for i = 1, entries do config[i] = i config['key' .. i] = i end");
+    printf("Table with %ld entries\n", entries * 2);
+
+    lua::Number sum = 0;
+    measure("Value::forEach", repeats, [&]() {
+        state["config"].forEach([&](const lua::StackSlot& key, const lua::StackSlot& value) {
+            sum += value.toNumber();
+        });
+    });
+
+    measure("Range for over Value", repeats, [&]() {
+        for (lua::TableEntry entry : state["config"])
+            sum += entry.value.toNumber();
+    });
+
+    // Only integer keys can be walked without iterator
+    measure("Value::operator[] with integer keys", repeats, [&]() {
+        lua::Value config = state["config"];
+        for (int i = 1; i <= entries; ++i)
+            sum += config[i].toNumber();
+    });
+
+    printf("Checksum %.0f\n", sum);
+    return 0;
+}
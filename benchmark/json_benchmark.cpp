@@ -0,0 +1,122 @@
+//
+//  json_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Pure Lua decoder, as scripts would parse JSON without State::pushJson. It handles documents of this benchmark.
+static const char* createLuaDecoder = R"(
+local find, sub, byte, tonumber = string.find, string.sub, string.byte, tonumber
+
+local function skip(text, position)
+    return find(text, '[^ \n\r\t]', position) or #text + 1
+end
+
+local decodeValue
+
+local function decodeString(text, position)
+    local last = find(text, '"', position + 1, true)
+    return sub(text, position + 1, last - 1), last + 1
+end
+
+function decodeValue(text, position)
+    position = skip(text, position)
+    local character = byte(text, position)
+
+    if character == 123 then
+        local object = {}
+        position = skip(text, position + 1)
+        if byte(text, position) == 125 then return object, position + 1 end
+        while true do
+            local key
+            key, position = decodeString(text, skip(text, position))
+            position = skip(text, position) + 1
+            object[key], position = decodeValue(text, position)
+            position = skip(text, position)
+            local separator = byte(text, position)
+            position = position + 1
+            if separator == 125 then return object, position end
+        end
+    elseif character == 91 then
+        local array = {}
+        position = skip(text, position + 1)
+        if byte(text, position) == 93 then return array, position + 1 end
+        while true do
+            array[#array + 1], position = decodeValue(text, position)
+            position = skip(text, position)
+            local separator = byte(text, position)
+            position = position + 1
+            if separator == 93 then return array, position end
+        end
+    elseif character == 34 then
+        return decodeString(text, position)
+    elseif sub(text, position, position + 3) == 'true' then
+        return true, position + 4
+    elseif sub(text, position, position + 4) == 'false' then
+        return false, position + 5
+    else
+        local first, last = find(text, '^-?[%d.eE+-]+', position)
+        return tonumber(sub(text, first, last)), last + 1
+    end
+end
+
+function decode(text)
+    return (decodeValue(text, 1))
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// @return JSON document with records similar to API responses
+static std::string createDocument(long records)
+{
+    std::string json = "[";
+    char record[256];
+    for (long i = 0; i < records; ++i) {
+        snprintf(record, sizeof(record),
+                 "%s\n  {\"id\": %ld, \"name\": \"user %ld\", \"email\": \"user%ld@example.com\", \"score\": %ld.5, "
+                 "\"active\": %s, \"tags\": [\"alpha\", \"beta\", \"gamma\"]}",
+                 i > 0 ? "," : "", i, i, i, i * 7, i % 2 ? "true" : "false");
+        json += record;
+    }
+    json += "\n]";
+    return json;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long records = iterations(argc, argv, 100000);
+    long repeats = 5;
+
+    std::string json = createDocument(records);
+    double megabytes = json.size() / 1048576.0;
+    printf("Document with %ld records has %.1f MB\n", records, megabytes);
+
+    lua::State state;
+    state.doString(createLuaDecoder);
+
+    double seconds = measure("State::pushJson", repeats, [&]() {
+        state.pushJson(json);
+    });
+    printf("%-40s %12.1f MB/s\n", "", megabytes * repeats / seconds);
+
+    state.set("document", state.pushJson(json));
+    std::string written;
+    seconds = measure("Value::toJson", repeats, [&]() {
+        written = state["document"].toJson();
+    });
+    printf("%-40s %12.1f MB/s\n", "", written.size() / 1048576.0 * repeats / seconds);
+
+    state.set("text", json);
+    seconds = measure("Lua decoder", repeats, [&]() {
+        state["decode"](state["text"]);
+    });
+    printf("%-40s %12.1f MB/s\n", "", megabytes * repeats / seconds);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+//
+//  numa_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* workScript = R"(
+function work()
+    local items = {}
+    for i = 1, 200 do
+        items[i] = { id = i, name = 'item' .. i }
+    end
+    local sum = 0
+    for i = 1, #items do sum = sum + items[i].id end
+    return sum
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void pinThread(unsigned core)
+{
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Every worker is pinned to its core and creates its own state
+static void benchmarkThreads(const char* name, const lua::StateOptions& options, unsigned threadCount, long count)
+{
+    std::vector<std::thread> threads;
+    std::vector<double> seconds(threadCount);
+    
+    for (unsigned i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&options, &seconds, i, count]() {
+            pinThread(i);
+            
+            lua::State state(options);
+            state.doString(workScript);
+            
+            auto start = std::chrono::steady_clock::now();
+            for (long j = 0; j < count; ++j) {
+                int sum = state["work"]();
+                (void)sum;
+            }
+            seconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+    }
+    
+    double total = 0;
+    for (unsigned i = 0; i < threadCount; ++i) {
+        threads[i].join();
+        total += count / seconds[i];
+    }
+    printf("%-40s %3u threads %12.0f calls/s per core %12.0f calls/s total\n", name, threadCount, total / threadCount, total);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 20000);
+    unsigned threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+    
+    lua::StateOptions options(lua::lib::Base | lua::lib::String | lua::lib::Table);
+    benchmarkThreads("default allocator", options, threadCount, count);
+    
+    options.poolAllocator = true;
+    benchmarkThreads("pool allocator", options, threadCount, count);
+    
+    options.poolPlacement = lua::MemoryPlacement(true, false);
+    benchmarkThreads("node local pool allocator", options, threadCount, count);
+    
+    options.poolPlacement = lua::MemoryPlacement(true, true);
+    benchmarkThreads("node local pool allocator, huge pages", options, threadCount, count);
+    
+    return 0;
+}
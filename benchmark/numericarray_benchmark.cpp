@@ -0,0 +1,76 @@
+//
+//  numericarray_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+#include "../include/LuaNumericArray.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Same operations written as Lua loops on plain tables
+static const char* createLuaKernels = R"(
+function tableSum(values)
+    local sum = 0
+    for i = 1, #values do sum = sum + values[i] end
+    return sum
+end
+
+function tableDot(first, second)
+    local sum = 0
+    for i = 1, #first do sum = sum + first[i] * second[i] end
+    return sum
+end
+
+function tableAxpy(factor, source, destination)
+    for i = 1, #destination do destination[i] = destination[i] + factor * source[i] end
+end
+
+function tableMax(values)
+    local max = values[1]
+    for i = 2, #values do if values[i] > max then max = values[i] end end
+    return max
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long size = iterations(argc, argv, 1000000);
+    long repeats = 20;
+
+    lua::State state;
+    state.doString(createLuaKernels);
+
+    std::vector<double> first(size), second(size);
+    std::vector<float> floats(size);
+    for (long i = 0; i < size; ++i) {
+        first[i] = (i % 1000) * 0.5;
+        second[i] = (i % 7) * 0.25;
+        floats[i] = static_cast<float>(first[i]);
+    }
+
+    state.set("first", lua::NumericArray<double>::wrap(first));
+    state.set("second", lua::NumericArray<double>::wrap(second));
+    state.set("floats", lua::NumericArray<float>::wrap(floats));
+    state.doString("firstTable = first:totable() secondTable = second:totable()");
+    printf("Arrays with %ld elements\n", size);
+
+    measure("Lua loop sum", repeats, [&]() { state.doString("return tableSum(firstTable)"); });
+    measure("NumericArray<double>::sum", repeats, [&]() { state.doString("return first:sum()"); });
+    measure("NumericArray<float>::sum", repeats, [&]() { state.doString("return floats:sum()"); });
+
+    measure("Lua loop dot", repeats, [&]() { state.doString("return tableDot(firstTable, secondTable)"); });
+    measure("NumericArray<double>::dot", repeats, [&]() { state.doString("return first:dot(second)"); });
+
+    measure("Lua loop max", repeats, [&]() { state.doString("return tableMax(firstTable)"); });
+    measure("NumericArray<double>::max", repeats, [&]() { state.doString("return first:max()"); });
+
+    measure("Lua loop axpy", repeats, [&]() { state.doString("tableAxpy(0.5, secondTable, firstTable)"); });
+    measure("NumericArray<double>::axpy", repeats, [&]() { state.doString("first:axpy(0.5, second)"); });
+
+    measure("Lua loop indexing of table", repeats, [&]() { state.doString("return tableSum(secondTable)"); });
+    measure("Lua loop indexing of NumericArray", repeats, [&]() { state.doString("return tableSum(second)"); });
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+//
+//  proxy_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+#include "../include/LuaProxy.h"
+
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Script reads only few settings from large configuration
+static const char* createHandler = R"(
+function handle(config)
+    return config['key 1'] + config['key 500'] + config['key 99999']
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long entries = iterations(argc, argv, 100000);
+    long repeats = 100;
+
+    std::unordered_map<std::string, double> config;
+    for (long i = 0; i < entries; ++i)
+        config["key " + std::to_string(i)] = static_cast<double>(i);
+    config["key 99999"] = 1;
+
+    lua::State state;
+    state.doString(createHandler);
+    lua_State* luaState = state.getState();
+    printf("Configuration with %ld entries\n", entries);
+
+    measure("Copy to table and call", repeats, [&]() {
+        lua_createtable(luaState, 0, static_cast<int>(config.size()));
+        for (const auto& entry : config) {
+            lua_pushlstring(luaState, entry.first.data(), entry.first.size());
+            lua_pushnumber(luaState, entry.second);
+            lua_rawset(luaState, -3);
+        }
+        lua_setglobal(luaState, "config");
+        state.doString("return handle(config)");
+    });
+
+    measure("Proxy and call", repeats, [&]() {
+        state.set("config", lua::Proxy(config));
+        state.doString("return handle(config)");
+    });
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+//
+//  scheduler_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+#include "../include/LuaScheduler.h"
+
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* scoreScript = R"(
+function score(id)
+    local words = {}
+    for i = 1, 100 do
+        words[i] = (id * 31 + i) % 97
+    end
+    local score = 0
+    for i = 1, #words do score = score + words[i] * i end
+    return score
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 200000);
+    unsigned maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads == 0)
+        maxThreads = 1;
+    
+    std::vector<int> inputs(count);
+    for (long i = 0; i < count; ++i)
+        inputs[i] = static_cast<int>(i);
+    
+    // Powers of two and all hardware threads
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    
+    double singleThread = 0;
+    for (unsigned threads : threadCounts) {
+        lua::Scheduler scheduler([](lua::State& state) {
+            state.doString(scoreScript);
+        }, threads);
+        
+        auto start = std::chrono::steady_clock::now();
+        std::vector<int> results = scheduler.parallelMap<int>("score", inputs);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        if (threads == 1)
+            singleThread = seconds;
+        printf("parallelMap %3u threads %12.0f calls/s %8.2fx speedup %10llu steals\n", threads, count / seconds,
+               singleThread / seconds, static_cast<unsigned long long>(scheduler.steals()));
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+//
+//  serialize_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* createInventories = R"(
+local itemNames = { 'sword', 'shield', 'potion', 'arrow', 'ring', 'helmet' }
+inventories = {}
+for i = 1, playerCount do
+    local items = {}
+    for j = 1, 20 do
+        items[j] = { name = itemNames[j % #itemNames + 1], count = j, durability = j * 0.5 }
+    end
+    inventories[i] = { player = 'player' .. i, gold = i * 10, items = items }
+end
+)";
+
+/// Naive serializer building Lua source, as scripts would do without Value::serialize
+static const char* createSerializer = R"(
+function serialize(value, out)
+    local kind = type(value)
+    if kind == 'table' then
+        out[#out + 1] = '{'
+        for k, v in pairs(value) do
+            out[#out + 1] = '['
+            serialize(k, out)
+            out[#out + 1] = ']='
+            serialize(v, out)
+            out[#out + 1] = ','
+        end
+        out[#out + 1] = '}'
+    elseif kind == 'string' then
+        out[#out + 1] = string.format('%q', value)
+    else
+        out[#out + 1] = tostring(value)
+    end
+    return out
+end
+
+function toText(value)
+    return 'return ' .. table.concat(serialize(value, {}))
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long repeats = iterations(argc, argv, 10);
+
+    lua::State state;
+    state.set("playerCount", 2000);
+    state.doString(createInventories);
+    state.doString(createSerializer);
+
+    std::string binary = state["inventories"].serialize();
+    std::string text = state["toText"](state["inventories"]);
+    printf("Binary size %zu bytes, text size %zu bytes\n", binary.size(), text.size());
+
+    measure("Value::serialize", repeats, [&]() {
+        std::string data = state["inventories"].serialize();
+    });
+
+    // Streaming reuses one buffer
+    char buffer[16384];
+    size_t streamed = 0;
+    measure("Value::serialize to buffer", repeats, [&]() {
+        streamed += state["inventories"].serialize(buffer, sizeof(buffer), [](const char* data, size_t size) {});
+    });
+
+    measure("State::deserialize", repeats, [&]() {
+        state.deserialize(binary);
+    });
+
+    measure("Lua serializer", repeats, [&]() {
+        std::string data = state["toText"](state["inventories"]);
+    });
+
+    measure("Lua deserializer (doString)", repeats, [&]() {
+        state.doString(text);
+    });
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+//
+//  state_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void benchmarkOptions(const char* name, const lua::StateOptions& options, long count)
+{
+    measure(name, count, [&options]() {
+        lua::State state(options);
+    });
+    
+    lua::State state(options);
+    printf("%-40s %12zu bytes\n", "  baseline memory", memoryUsage(state));
+    
+    if ((options.libraries & lua::lib::String) == 0)
+        return;
+    
+    // Typical tenant script uses only string and table libraries
+    measure("  create + run string/table script", count, [&options]() {
+        lua::State state(options);
+        state.doString("local t = {} table.insert(t, string.format('%d', 10))");
+    });
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 20000);
+    
+    unsigned tenantLibraries = lua::lib::Base | lua::lib::String | lua::lib::Table;
+    
+    benchmarkOptions("all libraries", lua::StateOptions(lua::lib::All), count);
+    benchmarkOptions("base, string, table", lua::StateOptions(tenantLibraries), count);
+    benchmarkOptions("all libraries lazy", lua::StateOptions(lua::lib::All, true), count);
+    benchmarkOptions("base, string, table lazy", lua::StateOptions(tenantLibraries, true), count);
+    benchmarkOptions("no libraries", lua::StateOptions(lua::lib::None), count);
+    
+    return 0;
+}
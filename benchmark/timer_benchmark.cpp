@@ -0,0 +1,73 @@
+//
+//  timer_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+#include "../include/LuaTimer.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* entityScript = R"(
+function entity(id)
+    local position = 0
+    while true do
+        position = position + 1
+        sleep(0.1 + (id % 50) * 0.01)
+    end
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 100000);
+    
+    // Timer wheel alone
+    {
+        lua::TimerWheel wheel;
+        std::vector<lua::TimerNode> nodes(count);
+        
+        long index = 0;
+        measure("TimerWheel::schedule", count, [&]() {
+            wheel.schedule(nodes[index], 1 + index % 5000);
+            ++index;
+        });
+        
+        index = 0;
+        measure("TimerWheel::cancel", count, [&]() {
+            wheel.cancel(nodes[index++]);
+        });
+        
+        for (long i = 0; i < count; ++i)
+            wheel.schedule(nodes[i], 1 + i % 5000);
+        
+        std::vector<lua::TimerNode*> expired;
+        measure("TimerWheel::advance", 5000, [&]() {
+            expired.clear();
+            wheel.advance(expired);
+        });
+    }
+    
+    // Sleeping coroutines of one state
+    {
+        lua::State state;
+        lua::CoroutineScheduler scheduler(state, 0.01);
+        state.doString(entityScript);
+        
+        size_t memory = memoryUsage(state);
+        long id = 0;
+        measure("CoroutineScheduler::spawn", count, [&]() {
+            scheduler.spawn(state["entity"], id++);
+        });
+        printf("%-40s %12.0f bytes per coroutine\n", "Memory", double(memoryUsage(state) - memory) / count);
+        
+        size_t resumed = 0;
+        double seconds = measure("CoroutineScheduler::tick", 600, [&]() {
+            resumed += scheduler.tick();
+        });
+        printf("%-40s %12.0f resumes/s %12.0f resumes per tick\n", "Resumed coroutines", resumed / seconds, resumed / 600.0);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,65 @@
+//
+//  timeslice_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+#include "../include/LuaTimeSlicer.h"
+
+#include <algorithm>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* tenantScript = R"(
+function long()
+    local sum = 0
+    for i = 1, 3000000 do sum = sum + i % 7 end
+    return sum
+end
+
+function short()
+    local sum = 0
+    for i = 1, 1000 do sum = sum + i % 7 end
+    return sum
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Latency of short scripts queued together with long ones
+static void benchmarkQuantum(const char* name, int quantum, long shortCount)
+{
+    lua::State state;
+    state.doString(tenantScript);
+    lua::TimeSlicer slicer(state, quantum);
+    
+    std::vector<double> latencies;
+    auto start = std::chrono::steady_clock::now();
+    auto finished = [&](uint64_t id, const lua::Value& result) {
+        latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    };
+    
+    for (long i = 0; i < shortCount; ++i) {
+        // Every tenth script is long
+        if (i % 10 == 0)
+            slicer.submit(state["long"]);
+        slicer.submit(state["short"], finished);
+    }
+    slicer.run();
+    
+    std::sort(latencies.begin(), latencies.end());
+    printf("%-40s p50 %10.2f ms  p99 %10.2f ms  %8llu preemptions\n", name, latencies[latencies.size() / 2],
+           latencies[latencies.size() * 99 / 100], static_cast<unsigned long long>(slicer.preemptions()));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long shortCount = iterations(argc, argv, 200);
+    
+    benchmarkQuantum("Without preemption", 1000000000, shortCount);
+    benchmarkQuantum("Quantum 100000", 100000, shortCount);
+    benchmarkQuantum("Quantum 10000", 10000, shortCount);
+    benchmarkQuantum("Quantum 1000", 1000, shortCount);
+    return 0;
+}
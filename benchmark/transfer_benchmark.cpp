@@ -0,0 +1,72 @@
+//
+//  transfer_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+#include "../include/LuaTransfer.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* createData = R"(
+data = {}
+for i = 1, recordCount do
+    local values = {}
+    for j = 1, 20 do values[j] = i * j end
+    data[i] = { id = i, name = 'record ' .. i, active = i % 2 == 0, tags = { 'red', 'green', 'blue' }, values = values }
+end
+)";
+
+/// Naive text transfer which user code would do without lua::transfer
+static const char* createSerializer = R"(
+function serialize(value, out)
+    local kind = type(value)
+    if kind == 'table' then
+        out[#out + 1] = '{'
+        for k, v in pairs(value) do
+            out[#out + 1] = '['
+            serialize(k, out)
+            out[#out + 1] = ']='
+            serialize(v, out)
+            out[#out + 1] = ','
+        end
+        out[#out + 1] = '}'
+    elseif kind == 'string' then
+        out[#out + 1] = string.format('%q', value)
+    else
+        out[#out + 1] = tostring(value)
+    end
+    return out
+end
+
+function toText(value)
+    return 'return ' .. table.concat(serialize(value, {}))
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 9000);
+    long repeats = 5;
+
+    lua::State source;
+    size_t before = memoryUsage(source);
+    source.set("recordCount", count);
+    source.doString(createData);
+    printf("Nested table with %ld records uses %.1f MB\n", count, (memoryUsage(source) - before) / 1048576.0);
+    source.doString(createSerializer);
+
+    measure("lua::transfer", repeats, [&]() {
+        lua::State destination;
+        destination.set("data", lua::transfer(source["data"], destination));
+    });
+
+    measure("Text serialization", repeats, [&]() {
+        lua::State destination;
+        std::string text = source["toText"](source["data"]);
+        destination.doString(text);
+    });
+
+    return 0;
+}
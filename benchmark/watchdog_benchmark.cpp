@@ -0,0 +1,46 @@
+//
+//  watchdog_benchmark.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "benchmark.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* workScript = R"(
+function work()
+    local sum = 0
+    for i = 1, 10000 do
+        sum = sum + (i % 7) * 3
+    end
+    return sum
+end
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Overhead of count hook with different granularities compared to calls without limits
+int main(int argc, char** argv)
+{
+    long count = iterations(argc, argv, 2000);
+    
+    lua::State state;
+    state.doString(workScript);
+    
+    lua::Value work = state["work"];
+    double baseline = measure("No limits", count, [&]() {
+        work.call();
+    });
+    
+    const int granularities[] = { 10, 100, 1000, 10000, 100000 };
+    for (int granularity : granularities) {
+        state.setExecutionLimits(1000000000ull, 60, granularity);
+        
+        char name[64];
+        snprintf(name, sizeof(name), "Granularity %d", granularity);
+        double seconds = measure(name, count, [&]() {
+            work.call();
+        });
+        printf("%-40s %11.2f %%\n", "Overhead", (seconds / baseline - 1) * 100);
+    }
+    return 0;
+}
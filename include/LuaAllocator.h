@@ -0,0 +1,626 @@
+//
+//  LuaAllocator.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+#ifdef __linux__
+#   include <sys/syscall.h>
+#endif
+
+namespace lua {
+    
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Placement of memory allocated by lua::PoolAllocator
+    struct MemoryPlacement
+    {
+        /// Default size of memory region which is mapped at once
+        static const size_t DefaultReservationSize = 2 * 1024 * 1024;
+        
+        /// When set, slabs are carved from memory regions, which are bound to NUMA node of thread creating allocator
+        /// and pre-faulted by this thread, so they are placed to its node also when binding is not supported
+        bool nodeLocal;
+        
+        /// When set, transparent huge pages are requested for memory regions
+        bool hugePages;
+        
+        /// Size of memory region mapped at once
+        size_t reservationSize;
+        
+        MemoryPlacement(bool nodeLocal = false, bool hugePages = false, size_t reservationSize = DefaultReservationSize)
+        : nodeLocal(nodeLocal)
+        , hugePages(hugePages)
+        , reservationSize(reservationSize)
+        {
+        }
+    };
+    
+    namespace detail {
+        
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Memory region mapped from system for node local allocations
+        struct MappedRegion {
+            void* memory;
+            size_t size;
+        };
+        
+        /// @return NUMA node of CPU which runs current thread, or -1 when it is not known
+        inline int current_numa_node() {
+#if defined(__linux__) && defined(SYS_getcpu)
+            unsigned cpu, node;
+            if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+                return static_cast<int>(node);
+#endif
+            return -1;
+        }
+        
+        /// Maps memory region, binds it to NUMA node of current thread and touches all its pages, so they are
+        /// faulted by current thread
+        ///
+        /// @return Region with null memory when mapping fails
+        inline MappedRegion map_region(size_t size, bool hugePages) {
+            MappedRegion region = { nullptr, size };
+#ifndef _WIN32
+            void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                return region;
+            
+#   if defined(__linux__) && defined(MADV_HUGEPAGE)
+            if (hugePages)
+                madvise(memory, size, MADV_HUGEPAGE);
+#   endif
+            
+#   if defined(__linux__) && defined(SYS_mbind)
+            // Preferred policy falls back to other nodes when node is full, it is MPOL_PREFERRED from numaif.h
+            int node = current_numa_node();
+            if (node >= 0 && node < static_cast<int>(sizeof(unsigned long) * 8)) {
+                const int preferredPolicy = 1;
+                unsigned long nodeMask = 1UL << node;
+                syscall(SYS_mbind, memory, size, preferredPolicy, &nodeMask, sizeof(nodeMask) * 8, 0);
+            }
+#   endif
+            
+            // First touch places pages to node of current thread
+            long pageSize = sysconf(_SC_PAGESIZE);
+            for (size_t offset = 0; offset < size; offset += pageSize)
+                static_cast<volatile char*>(memory)[offset] = 0;
+            
+            region.memory = memory;
+#else
+            region.memory = std::malloc(size);
+#endif
+            return region;
+        }
+        
+        inline void unmap_region(const MappedRegion& region) {
+#ifndef _WIN32
+            munmap(region.memory, region.size);
+#else
+            std::free(region.memory);
+#endif
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Allocator for lua::State which serves small blocks from size class free lists. Blocks are carved from
+    /// big slabs, so Lua strings, tables and closures do not go to system allocator. Big blocks are allocated
+    /// with std::realloc. Slabs are released when allocator is destroyed.
+    ///
+    /// Allocator is not locking, every lua::State must have its own instance. It relies on old block size passed
+    /// by Lua, so blocks don't need any header.
+    ///
+    /// With node local placement are slabs carved from memory regions owned by allocator, which are bound to NUMA
+    /// node of thread creating the allocator. Use it for states pinned to worker threads.
+    class PoolAllocator
+    {
+    public:
+
+        /// Blocks are rounded up to multiple of this size
+        static const size_t Granularity = 16;
+
+        /// Bigger blocks are allocated by system allocator
+        static const size_t MaxBlockSize = 256;
+
+        /// Number of size classes
+        static const size_t ClassCount = MaxBlockSize / Granularity;
+
+        /// Default size of slab
+        static const size_t DefaultSlabSize = 64 * 1024;
+
+    private:
+
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        /// Released blocks for each size class
+        FreeBlock* _freeLists[ClassCount];
+
+        /// All allocated slabs
+        std::vector<void*> _slabs;
+
+        /// Not used memory in current slab
+        char* _slabCurrent;
+        char* _slabEnd;
+
+        size_t _slabSize;
+        
+        MemoryPlacement _placement;
+        
+        /// Regions for node local slabs
+        std::vector<detail::MappedRegion> _regions;
+        
+        /// Not used memory in current region
+        char* _regionCurrent;
+        char* _regionEnd;
+        
+        void* allocateNodeLocalSlab() {
+            if (static_cast<size_t>(_regionEnd - _regionCurrent) < _slabSize) {
+                size_t size = _placement.reservationSize > _slabSize ? _placement.reservationSize : _slabSize;
+                detail::MappedRegion region = detail::map_region(size, _placement.hugePages);
+                if (region.memory == nullptr)
+                    return nullptr;
+                
+                _regions.push_back(region);
+                _regionCurrent = static_cast<char*>(region.memory);
+                _regionEnd = _regionCurrent + region.size;
+            }
+            
+            void* slab = _regionCurrent;
+            _regionCurrent += _slabSize;
+            return slab;
+        }
+
+        static size_t sizeClass(size_t size) {
+            return (size + Granularity - 1) / Granularity - 1;
+        }
+
+        void* allocateSlab() {
+            void* slab = _placement.nodeLocal ? allocateNodeLocalSlab() : std::malloc(_slabSize);
+            if (slab == nullptr)
+                return nullptr;
+
+            _slabs.push_back(slab);
+            _slabCurrent = static_cast<char*>(slab);
+            _slabEnd = _slabCurrent + _slabSize;
+            return slab;
+        }
+
+        void* allocateBlock(size_t size) {
+            size_t index = sizeClass(size);
+
+            FreeBlock* block = _freeLists[index];
+            if (block != nullptr) {
+                _freeLists[index] = block->next;
+                return block;
+            }
+
+            size_t blockSize = (index + 1) * Granularity;
+            if (static_cast<size_t>(_slabEnd - _slabCurrent) < blockSize) {
+
+                // Rest of current slab is given to free lists, so it will not be wasted
+                while (static_cast<size_t>(_slabEnd - _slabCurrent) >= Granularity) {
+                    size_t restSize = (_slabEnd - _slabCurrent) / Granularity * Granularity;
+                    if (restSize > MaxBlockSize)
+                        restSize = MaxBlockSize;
+                    
+                    releaseBlock(_slabCurrent, restSize);
+                    _slabCurrent += restSize;
+                }
+
+                if (allocateSlab() == nullptr)
+                    return nullptr;
+            }
+
+            void* memory = _slabCurrent;
+            _slabCurrent += blockSize;
+            return memory;
+        }
+
+        void releaseBlock(void* memory, size_t size) {
+            size_t index = sizeClass(size);
+            FreeBlock* block = static_cast<FreeBlock*>(memory);
+            block->next = _freeLists[index];
+            _freeLists[index] = block;
+        }
+
+    public:
+
+        /// Creates allocator, slabs are allocated when first needed
+        ///
+        /// @param slabSize     Size of memory which will be allocated from system when size class is empty
+        /// @param placement    Placement of slabs. Node local region is mapped in constructor by current thread.
+        PoolAllocator(size_t slabSize = DefaultSlabSize, const MemoryPlacement& placement = MemoryPlacement())
+        : _slabCurrent(nullptr)
+        , _slabEnd(nullptr)
+        , _slabSize((slabSize < MaxBlockSize ? MaxBlockSize : slabSize) / Granularity * Granularity)
+        , _placement(placement)
+        , _regionCurrent(nullptr)
+        , _regionEnd(nullptr)
+        {
+            for (size_t i = 0; i < ClassCount; ++i)
+                _freeLists[i] = nullptr;
+            
+            // Memory is reserved by creating thread
+            if (_placement.nodeLocal)
+                allocateSlab();
+        }
+
+        ~PoolAllocator() {
+            if (_placement.nodeLocal) {
+                for (const detail::MappedRegion& region : _regions)
+                    detail::unmap_region(region);
+            }
+            else {
+                for (void* slab : _slabs)
+                    std::free(slab);
+            }
+        }
+
+        // Allocator is non-copyable, Lua state has pointer to it
+        PoolAllocator(const PoolAllocator& other) = delete;
+        PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+        /// Allocation function with same semantics as lua_Alloc
+        void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
+
+            // In Lua 5.2+ old size contains type of allocated object when pointer is null
+            if (pointer == nullptr)
+                oldSize = 0;
+
+            if (newSize == 0) {
+                if (oldSize > MaxBlockSize)
+                    std::free(pointer);
+                else if (pointer != nullptr)
+                    releaseBlock(pointer, oldSize);
+                return nullptr;
+            }
+
+            if (oldSize > MaxBlockSize && newSize > MaxBlockSize)
+                return std::realloc(pointer, newSize);
+
+            // Block is already in same size class
+            if (pointer != nullptr && oldSize <= MaxBlockSize && newSize <= MaxBlockSize && sizeClass(oldSize) == sizeClass(newSize))
+                return pointer;
+
+            void* memory = newSize > MaxBlockSize ? std::malloc(newSize) : allocateBlock(newSize);
+            if (memory == nullptr)
+                return nullptr;
+
+            if (pointer != nullptr) {
+                memcpy(memory, pointer, oldSize < newSize ? oldSize : newSize);
+                reallocate(pointer, oldSize, 0);
+            }
+            return memory;
+        }
+
+        /// Function which can be passed to lua_newstate or lua::State constructor with pointer to allocator as
+        /// user data
+        static void* allocate(void* userData, void* pointer, size_t oldSize, size_t newSize) {
+            return static_cast<PoolAllocator*>(userData)->reallocate(pointer, oldSize, newSize);
+        }
+
+        /// @return Bytes allocated from system for slabs
+        size_t slabMemory() const {
+            return _slabs.size() * _slabSize;
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Bump allocator for short living lua::State. Blocks are allocated from big chunks, released blocks are not
+    /// reused and all memory is released at once when allocator is destroyed or reset. Growing of last allocated
+    /// block is done in place.
+    ///
+    /// Allocator is not locking, every lua::State must have its own instance.
+    class ArenaAllocator
+    {
+    public:
+        
+        /// All blocks are aligned to this size
+        static const size_t Alignment = 16;
+        
+        /// Default size of chunk
+        static const size_t DefaultChunkSize = 256 * 1024;
+        
+    private:
+        
+        struct Chunk {
+            Chunk* previous;
+            size_t size;
+        };
+        
+        /// Chunk header is padded, so blocks are aligned
+        static const size_t ChunkHeaderSize = (sizeof(Chunk) + Alignment - 1) / Alignment * Alignment;
+        
+        /// Last allocated chunk, chunks are linked to list
+        Chunk* _chunk;
+        
+        /// Not used memory in last chunk
+        char* _current;
+        char* _end;
+        
+        /// Last allocated block, which can be resized in place
+        char* _last;
+        
+        size_t _chunkSize;
+        
+        /// Bytes of all chunks
+        size_t _chunkMemory;
+        
+        static size_t align(size_t size) {
+            return (size + Alignment - 1) / Alignment * Alignment;
+        }
+        
+        bool allocateChunk(size_t size) {
+            size_t chunkSize = size + ChunkHeaderSize > _chunkSize ? size + ChunkHeaderSize : _chunkSize;
+            Chunk* chunk = static_cast<Chunk*>(std::malloc(chunkSize));
+            if (chunk == nullptr)
+                return false;
+            
+            chunk->previous = _chunk;
+            chunk->size = chunkSize;
+            _chunk = chunk;
+            _chunkMemory += chunkSize;
+            
+            _current = reinterpret_cast<char*>(chunk) + ChunkHeaderSize;
+            _end = reinterpret_cast<char*>(chunk) + chunkSize;
+            _last = nullptr;
+            return true;
+        }
+        
+        void* allocateBlock(size_t size) {
+            size = align(size);
+            if (static_cast<size_t>(_end - _current) < size && !allocateChunk(size))
+                return nullptr;
+            
+            _last = _current;
+            _current += size;
+            return _last;
+        }
+        
+        void releaseChunks(Chunk* chunk) {
+            while (chunk != nullptr) {
+                Chunk* previous = chunk->previous;
+                _chunkMemory -= chunk->size;
+                std::free(chunk);
+                chunk = previous;
+            }
+        }
+        
+    public:
+        
+        /// Creates allocator, chunks are allocated when first needed
+        ///
+        /// @param chunkSize    Size of memory which will be allocated from system when chunk is full
+        ArenaAllocator(size_t chunkSize = DefaultChunkSize)
+        : _chunk(nullptr)
+        , _current(nullptr)
+        , _end(nullptr)
+        , _last(nullptr)
+        , _chunkSize(chunkSize)
+        , _chunkMemory(0)
+        {
+        }
+        
+        ~ArenaAllocator() {
+            releaseChunks(_chunk);
+        }
+        
+        // Allocator is non-copyable, Lua state has pointer to it
+        ArenaAllocator(const ArenaAllocator& other) = delete;
+        ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+        
+        /// Releases all allocated blocks at once. First chunk is kept, so allocator can be used for next lua::State
+        /// without allocating memory from system.
+        ///
+        /// @note Lua state using this allocator must be already closed or discarded
+        void reset() {
+            if (_chunk == nullptr)
+                return;
+            
+            // Find first chunk
+            Chunk* first = _chunk;
+            while (first->previous != nullptr)
+                first = first->previous;
+            
+            if (first != _chunk) {
+                Chunk* chunk = _chunk;
+                while (chunk->previous != first)
+                    chunk = chunk->previous;
+                chunk->previous = nullptr;
+                releaseChunks(_chunk);
+            }
+            
+            _chunk = first;
+            _current = reinterpret_cast<char*>(first) + ChunkHeaderSize;
+            _end = reinterpret_cast<char*>(first) + first->size;
+            _last = nullptr;
+        }
+        
+        /// Allocation function with same semantics as lua_Alloc
+        void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
+            
+            // In Lua 5.2+ old size contains type of allocated object when pointer is null
+            if (pointer == nullptr)
+                oldSize = 0;
+            
+            // Only last block can be returned to arena
+            if (newSize == 0) {
+                if (pointer != nullptr && pointer == _last) {
+                    _current = _last;
+                    _last = nullptr;
+                }
+                return nullptr;
+            }
+            
+            if (pointer == nullptr)
+                return allocateBlock(newSize);
+            
+            // Last block can grow or shrink in place
+            if (pointer == _last && static_cast<size_t>(_end - _last) >= align(newSize)) {
+                _current = _last + align(newSize);
+                return pointer;
+            }
+            
+            if (newSize <= oldSize)
+                return pointer;
+            
+            void* memory = allocateBlock(newSize);
+            if (memory != nullptr)
+                memcpy(memory, pointer, oldSize);
+            return memory;
+        }
+        
+        /// Function which can be passed to lua_newstate or lua::State constructor with pointer to allocator as
+        /// user data
+        static void* allocate(void* userData, void* pointer, size_t oldSize, size_t newSize) {
+            return static_cast<ArenaAllocator*>(userData)->reallocate(pointer, oldSize, newSize);
+        }
+        
+        /// @return Bytes allocated from system for chunks
+        size_t chunkMemory() const {
+            return _chunkMemory;
+        }
+    };
+    
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Memory statistics of lua::State
+    struct MemoryStats
+    {
+        /// Number of size buckets, bucket i counts allocations up to 16 * 2^i bytes and last bucket bigger ones
+        static const size_t BucketCount = 12;
+        
+        /// Currently allocated bytes
+        size_t liveBytes;
+        
+        /// Maximum of allocated bytes
+        size_t peakBytes;
+        
+        /// Hard limit of allocated bytes, zero when state is not limited
+        size_t limit;
+        
+        /// Number of allocated and reallocated blocks
+        size_t allocations;
+        
+        /// Number of released blocks
+        size_t releases;
+        
+        /// Number of allocations refused because of limit or failed in allocator
+        size_t failedAllocations;
+        
+        /// Number of allocations by size
+        size_t allocationsBySize[BucketCount];
+        
+        MemoryStats()
+        : liveBytes(0)
+        , peakBytes(0)
+        , limit(0)
+        , allocations(0)
+        , releases(0)
+        , failedAllocations(0)
+        {
+            for (size_t i = 0; i < BucketCount; ++i)
+                allocationsBySize[i] = 0;
+        }
+        
+        /// @return Index to allocationsBySize for given size
+        static size_t bucket(size_t size) {
+            size_t bucket = 0;
+            for (size_t bucketSize = 16; bucketSize < size && bucket < BucketCount - 1; bucketSize <<= 1)
+                ++bucket;
+            return bucket;
+        }
+    };
+    
+    namespace detail {
+        
+        /// Same allocation function as luaL_newstate uses
+        inline void* default_allocate(void*, void* pointer, size_t, size_t newSize) {
+            if (newSize == 0) {
+                std::free(pointer);
+                return nullptr;
+            }
+            return std::realloc(pointer, newSize);
+        }
+        
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Allocator wrapper which counts memory statistics and refuses allocations over limit. When allocation is
+        /// refused, Lua raises memory error.
+        class MemoryTracker
+        {
+            lua_Alloc _allocator;
+            void* _allocatorData;
+            MemoryStats _stats;
+            
+        public:
+            
+            MemoryTracker(lua_Alloc allocator, void* allocatorData, size_t limit)
+            : _allocator(allocator != nullptr ? allocator : &default_allocate)
+            , _allocatorData(allocator != nullptr ? allocatorData : nullptr)
+            {
+                _stats.limit = limit;
+            }
+            
+            void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
+                
+                // In Lua 5.2+ old size contains type of allocated object when pointer is null
+                if (pointer == nullptr)
+                    oldSize = 0;
+                
+                if (newSize == 0) {
+                    if (pointer != nullptr) {
+                        _stats.liveBytes -= oldSize;
+                        ++_stats.releases;
+                    }
+                    return _allocator(_allocatorData, pointer, oldSize, 0);
+                }
+                
+                // Shrinking blocks must not fail, so only growing is limited
+                if (_stats.limit != 0 && newSize > oldSize && _stats.liveBytes + (newSize - oldSize) > _stats.limit) {
+                    ++_stats.failedAllocations;
+                    return nullptr;
+                }
+                
+                void* memory = _allocator(_allocatorData, pointer, oldSize, newSize);
+                if (memory == nullptr) {
+                    ++_stats.failedAllocations;
+                    return nullptr;
+                }
+                
+                _stats.liveBytes += newSize - oldSize;
+                if (_stats.liveBytes > _stats.peakBytes)
+                    _stats.peakBytes = _stats.liveBytes;
+                
+                ++_stats.allocations;
+                ++_stats.allocationsBySize[MemoryStats::bucket(newSize)];
+                return memory;
+            }
+            
+            static void* allocate(void* userData, void* pointer, size_t oldSize, size_t newSize) {
+                return static_cast<MemoryTracker*>(userData)->reallocate(pointer, oldSize, newSize);
+            }
+            
+            const MemoryStats& stats() const { return _stats; }
+            
+            void setLimit(size_t limit) { _stats.limit = limit; }
+        };
+
+        /// Same panic function as luaL_newstate uses
+        inline int panic(lua_State* luaState) {
+            fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(luaState, -1));
+            return 0;
+        }
+    }
+}
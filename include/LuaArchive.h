@@ -0,0 +1,357 @@
+//
+//  LuaArchive.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <cstdint>
+
+#ifndef _WIN32
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+namespace lua {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sorted collection of Lua modules (source or precompiled bytecode) that are kept in memory.
+    /// Modules can be embedded into executable as static arrays or loaded from single archive file,
+    /// which is memory mapped. Chunks are never copied, they are loaded directly from archive memory.
+    ///
+    /// Archive image layout (all integers are 32 bit little endian):
+    ///
+    ///     "LUAR" | version | count | count * (nameOffset, nameLength, dataOffset, dataLength) | names and data
+    ///
+    /// Index entries are sorted by module name, so lookup is binary search.
+    class ScriptArchive
+    {
+    public:
+
+        /// Single module stored in archive. Pointers are pointing to memory owned by archive or to user's static data.
+        struct Entry {
+            const char* name;
+            size_t nameLength;
+            const char* data;
+            size_t size;
+        };
+
+    private:
+
+        /// Entries sorted by name
+        std::vector<Entry> _entries;
+
+        /// Names of modules added with add function
+        std::vector<std::unique_ptr<std::string>> _names;
+
+        /// Memory mapped archive file
+        void* _mapping;
+        size_t _mappingSize;
+
+        /// Archive image when memory mapping is not available
+        std::string _image;
+
+        static const uint32_t Version = 1;
+        static const size_t HeaderSize = 12;
+        static const size_t EntrySize = 16;
+
+        static uint32_t readUInt32(const char* data) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+            return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+        }
+
+        static void writeUInt32(std::string& image, uint32_t value) {
+            image.push_back(static_cast<char>(value & 0xff));
+            image.push_back(static_cast<char>((value >> 8) & 0xff));
+            image.push_back(static_cast<char>((value >> 16) & 0xff));
+            image.push_back(static_cast<char>((value >> 24) & 0xff));
+        }
+
+        static int compare(const char* lhs, size_t lhsLength, const char* rhs, size_t rhsLength) {
+            int result = memcmp(lhs, rhs, lhsLength < rhsLength ? lhsLength : rhsLength);
+            if (result != 0)
+                return result;
+            return lhsLength < rhsLength ? -1 : (lhsLength > rhsLength ? 1 : 0);
+        }
+
+        static bool entryLess(const Entry& lhs, const Entry& rhs) {
+            return compare(lhs.name, lhs.nameLength, rhs.name, rhs.nameLength) < 0;
+        }
+
+        void unmap() {
+#ifndef _WIN32
+            if (_mapping != nullptr)
+                munmap(_mapping, _mappingSize);
+#endif
+            _mapping = nullptr;
+            _mappingSize = 0;
+        }
+
+    public:
+
+        ScriptArchive() : _mapping(nullptr), _mappingSize(0) {}
+
+        ~ScriptArchive() { unmap(); }
+
+        // Archive is non-copyable, because entries are pointing to its memory
+        ScriptArchive(const ScriptArchive& other) = delete;
+        ScriptArchive& operator=(const ScriptArchive&) = delete;
+
+        /// Adds module to archive. Data are not copied, so they must be valid until archive is destroyed.
+        ///
+        /// @param name     Module name as used in require function, for example "game.config"
+        /// @param data     Lua source or precompiled bytecode
+        /// @param size     Size of data in bytes
+        void add(const std::string& name, const char* data, size_t size) {
+            _names.emplace_back(new std::string(name));
+            const std::string& storedName = *_names.back();
+
+            Entry entry = { storedName.c_str(), storedName.length(), data, size };
+            auto position = std::lower_bound(_entries.begin(), _entries.end(), entry, &ScriptArchive::entryLess);
+
+            // Newer module replaces older one with same name
+            if (position != _entries.end() && !entryLess(entry, *position))
+                *position = entry;
+            else
+                _entries.insert(position, entry);
+        }
+
+        /// Uses archive image which was created with image() function. Image is not copied, so it must be valid until
+        /// archive is destroyed. Useful for archive files which were embedded to executable.
+        ///
+        /// @return false when image is not valid archive
+        bool load(const char* image, size_t size) {
+            if (size < HeaderSize || memcmp(image, "LUAR", 4) != 0 || readUInt32(image + 4) != Version)
+                return false;
+
+            size_t count = readUInt32(image + 8);
+            if ((size - HeaderSize) / EntrySize < count)
+                return false;
+
+            std::vector<Entry> entries;
+            entries.reserve(count);
+
+            for (size_t i = 0; i < count; ++i) {
+                const char* index = image + HeaderSize + i * EntrySize;
+                size_t nameOffset = readUInt32(index);
+                size_t nameLength = readUInt32(index + 4);
+                size_t dataOffset = readUInt32(index + 8);
+                size_t dataLength = readUInt32(index + 12);
+
+                if (nameOffset > size || nameLength > size - nameOffset || dataOffset > size || dataLength > size - dataOffset)
+                    return false;
+
+                Entry entry = { image + nameOffset, nameLength, image + dataOffset, dataLength };
+                entries.push_back(entry);
+            }
+
+            // Index must be sorted, otherwise binary search will not work
+            if (!std::is_sorted(entries.begin(), entries.end(), &ScriptArchive::entryLess))
+                std::sort(entries.begin(), entries.end(), &ScriptArchive::entryLess);
+
+            for (const Entry& entry : entries) {
+                auto position = std::lower_bound(_entries.begin(), _entries.end(), entry, &ScriptArchive::entryLess);
+                if (position != _entries.end() && !entryLess(entry, *position))
+                    *position = entry;
+                else
+                    _entries.insert(position, entry);
+            }
+            return true;
+        }
+
+        /// Maps archive file to memory and uses it. On platforms without memory mapping is file read to memory.
+        ///
+        /// @param filePath Path to archive file created from image() function
+        ///
+        /// @return false when file cannot be opened, it is not valid archive or other file was already opened
+        bool open(const std::string& filePath) {
+            // Entries are pointing to opened file, so it can't be replaced
+            if (_mapping != nullptr || !_image.empty())
+                return false;
+
+#ifndef _WIN32
+            int file = ::open(filePath.c_str(), O_RDONLY);
+            if (file < 0)
+                return false;
+
+            struct stat fileStat;
+            if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+                close(file);
+                return false;
+            }
+
+            void* mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            close(file);
+
+            if (mapping == MAP_FAILED)
+                return false;
+
+            if (!load(static_cast<const char*>(mapping), fileStat.st_size)) {
+                munmap(mapping, fileStat.st_size);
+                return false;
+            }
+
+            _mapping = mapping;
+            _mappingSize = fileStat.st_size;
+            return true;
+#else
+            std::ifstream file(filePath.c_str(), std::ios::in | std::ios::binary);
+            if (!file)
+                return false;
+
+            std::string image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (!load(image.data(), image.size()))
+                return false;
+
+            // Entries are pointing to image, so we must keep it
+            _image.swap(image);
+            return true;
+#endif
+        }
+
+        /// Creates archive image from all modules in archive. It can be saved to file and later used with open()
+        /// function or embedded to executable and used with load() function.
+        ///
+        /// @return Archive image
+        std::string image() const {
+            std::string image("LUAR");
+            writeUInt32(image, Version);
+            writeUInt32(image, static_cast<uint32_t>(_entries.size()));
+
+            size_t offset = HeaderSize + _entries.size() * EntrySize;
+            for (const Entry& entry : _entries) {
+                writeUInt32(image, static_cast<uint32_t>(offset));
+                writeUInt32(image, static_cast<uint32_t>(entry.nameLength));
+                writeUInt32(image, static_cast<uint32_t>(offset + entry.nameLength));
+                writeUInt32(image, static_cast<uint32_t>(entry.size));
+                offset += entry.nameLength + entry.size;
+            }
+
+            for (const Entry& entry : _entries) {
+                image.append(entry.name, entry.nameLength);
+                image.append(entry.data, entry.size);
+            }
+            return image;
+        }
+
+        /// Finds module with binary search
+        ///
+        /// @return Found entry or nullptr
+        const Entry* find(const char* name, size_t length) const {
+            size_t low = 0;
+            size_t high = _entries.size();
+
+            while (low < high) {
+                size_t middle = low + (high - low) / 2;
+                const Entry& entry = _entries[middle];
+
+                int result = compare(entry.name, entry.nameLength, name, length);
+                if (result == 0)
+                    return &entry;
+                else if (result < 0)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+            return nullptr;
+        }
+
+        const Entry* find(const std::string& name) const {
+            return find(name.c_str(), name.length());
+        }
+
+        /// @return Number of modules in archive
+        size_t size() const { return _entries.size(); }
+    };
+
+    namespace detail {
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Searcher for package.loaders (Lua 5.1) or package.searchers (Lua 5.2+) table. It has one upvalue with
+        /// pointer to list of archives of lua::State.
+        inline int archiveSearcher(lua_State* luaState) {
+            const std::vector<const ScriptArchive*>* archives = static_cast<const std::vector<const ScriptArchive*>*>(lua_touserdata(luaState, lua_upvalueindex(1)));
+
+            size_t length;
+            const char* name = luaL_checklstring(luaState, 1, &length);
+
+            for (const ScriptArchive* archive : *archives) {
+                const ScriptArchive::Entry* entry = archive->find(name, length);
+                if (entry == nullptr)
+                    continue;
+
+                // Chunk name is kept on stack, luaL_error would jump over destructor of std::string
+                const char* chunkName = lua_pushfstring(luaState, "=%s", name);
+                if (luaL_loadbuffer(luaState, entry->data, entry->size, chunkName) != 0)
+                    return luaL_error(luaState, "error loading module '%s' from archive:\n\t%s", name, lua_tostring(luaState, -1));
+                lua_remove(luaState, -2);
+
+                // Lua 5.2+ passes second value to loader
+                lua_pushvalue(luaState, 1);
+                return 2;
+            }
+
+            lua_pushfstring(luaState, "\n\tno module '%s' in archives", name);
+            return 1;
+        }
+
+        /// Installs archive searcher right after preload searcher, so archives are searched before file system.
+        /// When searcher is already installed, nothing is done.
+        ///
+        /// @return false when package library is not loaded
+        inline bool install_archive_searcher(lua_State* luaState, const std::vector<const ScriptArchive*>* archives) {
+            lua_getglobal(luaState, "package");
+            if (!lua_istable(luaState, -1)) {
+                lua_pop(luaState, 1);
+                return false;
+            }
+
+#if LUA_VERSION_NUM > 501
+            lua_getfield(luaState, -1, "searchers");
+#else
+            lua_getfield(luaState, -1, "loaders");
+#endif
+            if (!lua_istable(luaState, -1)) {
+                lua_pop(luaState, 2);
+                return false;
+            }
+
+#if LUA_VERSION_NUM > 501
+            int count = static_cast<int>(lua_rawlen(luaState, -1));
+#else
+            int count = static_cast<int>(lua_objlen(luaState, -1));
+#endif
+            
+            // Searcher can be already installed
+            for (int i = 1; i <= count; ++i) {
+                lua_rawgeti(luaState, -1, i);
+                bool installed = lua_tocfunction(luaState, -1) == &archiveSearcher;
+                lua_pop(luaState, 1);
+                
+                if (installed) {
+                    lua_pop(luaState, 2);
+                    return true;
+                }
+            }
+
+            // Move searchers from second position up
+            for (int i = count; i >= 2; --i) {
+                lua_rawgeti(luaState, -1, i);
+                lua_rawseti(luaState, -2, i + 1);
+            }
+
+            lua_pushlightuserdata(luaState, const_cast<std::vector<const ScriptArchive*>*>(archives));
+            lua_pushcclosure(luaState, &archiveSearcher, 1);
+            lua_rawseti(luaState, -2, count >= 1 ? 2 : 1);
+
+            lua_pop(luaState, 2);
+            return true;
+        }
+    }
+}
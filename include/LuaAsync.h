@@ -0,0 +1,370 @@
+//
+//  LuaAsync.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+#include "./LuaQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace lua {
+
+    namespace detail {
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Result of asynchronous operation, it resumes waiting coroutine on event loop thread
+        struct AsyncResult {
+            lua_State* thread;
+            std::function<Value(Coroutine&)> resume;
+        };
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Queue of finished asynchronous operations. It is shared by event loop and all completions, so operations
+        /// can finish even after event loop was destroyed.
+        struct AsyncQueue
+        {
+            MpscQueue<AsyncResult> results;
+
+            /// Set when event loop waits for results
+            std::atomic<bool> sleeping;
+            std::mutex mutex;
+            std::condition_variable condition;
+
+            AsyncQueue() : sleeping(false) {}
+
+            /// Can be called from any thread
+            void push(AsyncResult&& result) {
+                results.push(std::move(result));
+                if (sleeping.load()) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    condition.notify_one();
+                }
+            }
+        };
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Asynchronous call waiting for result. When all copies of completion are destroyed without result,
+        /// coroutine is resumed with error.
+        class AsyncCall
+        {
+            std::shared_ptr<AsyncQueue> _queue;
+            lua_State* _thread;
+            std::atomic<bool> _finished;
+
+        public:
+
+            AsyncCall(const std::shared_ptr<AsyncQueue>& queue, lua_State* thread)
+            : _queue(queue)
+            , _thread(thread)
+            , _finished(false)
+            {
+            }
+
+            ~AsyncCall() {
+                fail("asynchronous operation was abandoned");
+            }
+
+            /// Passes result to event loop, only first result is used
+            void finish(std::function<Value(Coroutine&)>&& resume) {
+                if (_finished.exchange(true))
+                    return;
+
+                AsyncResult result = { _thread, std::move(resume) };
+                _queue->push(std::move(result));
+            }
+
+            void fail(const std::string& message) {
+                finish([message](Coroutine& coroutine) { return coroutine.resume(false, message); });
+            }
+        };
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Callback of asynchronous C++ function. It can be copied and called from any thread, calling coroutine is
+    /// resumed on event loop thread with given value.
+    template <typename R>
+    class Completion
+    {
+        std::shared_ptr<detail::AsyncCall> _call;
+
+    public:
+
+        Completion(const std::shared_ptr<detail::AsyncCall>& call) : _call(call) {}
+
+        /// Returns value to calling coroutine
+        void operator()(R value) const {
+            _call->finish([value](Coroutine& coroutine) { return coroutine.resume(true, value); });
+        }
+
+        /// Raises error in calling coroutine
+        void fail(const std::string& message) const {
+            _call->fail(message);
+        }
+    };
+
+    template <>
+    class Completion<void>
+    {
+        std::shared_ptr<detail::AsyncCall> _call;
+
+    public:
+
+        Completion(const std::shared_ptr<detail::AsyncCall>& call) : _call(call) {}
+
+        /// Resumes calling coroutine
+        void operator()() const {
+            _call->finish([](Coroutine& coroutine) { return coroutine.resume(true); });
+        }
+
+        /// Raises error in calling coroutine
+        void fail(const std::string& message) const {
+            _call->fail(message);
+        }
+    };
+
+    class EventLoop;
+
+    namespace detail {
+
+        /// Starts asynchronous call from coroutine of event loop
+        ///
+        /// @return Shared state of completion or nullptr when thread is not coroutine of event loop
+        inline std::shared_ptr<AsyncCall> begin_async_call(EventLoop* loop, lua_State* luaState);
+
+#if LUA_VERSION_NUM > 501
+        /// Continuation of asynchronous function. Stack contains values passed to resume: success flag and result
+        /// or error message.
+#   if LUA_VERSION_NUM > 502
+        inline int asyncContinuation(lua_State* luaState, int status, lua_KContext context) {
+#   else
+        inline int asyncContinuation(lua_State* luaState) {
+#   endif
+            if (!lua_toboolean(luaState, 1)) {
+                lua_pushvalue(luaState, 2);
+                return lua_error(luaState);
+            }
+            return lua_gettop(luaState) - 1;
+        }
+#endif
+
+        /// Yields coroutine which is waiting for asynchronous result
+        inline int yield_async(lua_State* luaState) {
+            lua_settop(luaState, 0);
+#if LUA_VERSION_NUM > 501
+            return lua_yieldk(luaState, 0, 0, &asyncContinuation);
+#else
+            // Success flag is checked by Lua wrapper created in EventLoop::bind
+            return lua_yield(luaState, 0);
+#endif
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Functor of asynchronous function. Arguments are read from stack, completion is added as last argument and
+        /// calling coroutine yields until completion is called.
+        template <typename Ret, typename ... Args>
+        struct AsyncFunctor : public BaseFunctor {
+            std::function<void(Args..., Completion<Ret>)> function;
+            EventLoop* loop;
+
+            AsyncFunctor(std::function<void(Args..., Completion<Ret>)> function, EventLoop* loop)
+            : BaseFunctor()
+            , function(function)
+            , loop(loop)
+            {
+            }
+
+            int call(lua_State* luaState) {
+                std::shared_ptr<AsyncCall> asyncCall = begin_async_call(loop, luaState);
+                if (!asyncCall)
+                    return luaL_error(luaState, "asynchronous function must be called from coroutine of event loop");
+
+                traits::apply_no_ret(function, std::tuple_cat(stack::get_and_pop<Args...>(luaState, nullptr, 2), std::make_tuple(Completion<Ret>(asyncCall))));
+                return yield_async(luaState);
+            }
+        };
+
+        template <typename Signature>
+        struct AsyncSignature;
+
+        template <typename Ret, typename ... Args>
+        struct AsyncSignature<Ret(Args...)> {
+            typedef std::function<void(Args..., Completion<Ret>)> Function;
+            typedef AsyncFunctor<Ret, Args...> Functor;
+        };
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs coroutines of one state, which are calling asynchronous C++ functions. Coroutine yields when it calls
+    /// asynchronous function and it is resumed by event loop when result is ready, so thousands of requests can be
+    /// in flight on single thread.
+    class EventLoop
+    {
+        friend std::shared_ptr<detail::AsyncCall> detail::begin_async_call(EventLoop* loop, lua_State* luaState);
+
+        State& _state;
+        std::shared_ptr<detail::AsyncQueue> _queue;
+
+        /// Coroutines which are not finished
+        std::unordered_map<lua_State*, std::unique_ptr<Coroutine>> _coroutines;
+
+        /// Coroutines waiting for asynchronous result
+        std::unordered_set<lua_State*> _waiting;
+
+        /// Coroutines which yielded without asynchronous call, they are resumed in next poll
+        std::vector<lua_State*> _ready;
+
+        /// Resumes coroutine and checks whether it finished
+        void resume(lua_State* thread, const std::function<Value(Coroutine&)>& resume) {
+            auto found = _coroutines.find(thread);
+            if (found == _coroutines.end())
+                return;
+
+            Coroutine& coroutine = *found->second;
+            try {
+                resume(coroutine);
+            } catch (...) {
+                _waiting.erase(thread);
+                _coroutines.erase(found);
+                throw;
+            }
+
+            if (coroutine.status() == Coroutine::Dead)
+                _coroutines.erase(found);
+            else if (_waiting.count(thread) == 0)
+                _ready.push_back(thread);
+        }
+
+    public:
+
+        EventLoop(State& state)
+        : _state(state)
+        , _queue(std::make_shared<detail::AsyncQueue>())
+        {
+        }
+
+        // Event loop is non-copyable
+        EventLoop(const EventLoop& other) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+
+        /// Sets global asynchronous function. Function gets arguments and completion, which must be called with
+        /// result. Calling coroutine yields until completion is called.
+        ///
+        /// Example: loop.bind<int(std::string)>("fetch", [](std::string key, lua::Completion<int> done) { ... });
+        ///
+        /// @param name     Name of global function
+        /// @param function Function with arguments from signature and lua::Completion as last argument
+        template <typename Signature>
+        void bind(lua::String name, typename detail::AsyncSignature<Signature>::Function function) {
+            lua_State* luaState = _state.getState();
+
+#if LUA_VERSION_NUM <= 501
+            // Lua 5.1 has no continuations, so error flag is checked by Lua function
+            luaL_loadstring(luaState, R"(
+                local call = ...
+                local function check(success, ...)
+                    if not success then error((...), 2) end
+                    return ...
+                end
+                return function(...) return check(call(...)) end
+            )");
+#endif
+
+            BaseFunctor** udata = (BaseFunctor **)lua_newuserdata(luaState, sizeof(BaseFunctor *));
+            *udata = new typename detail::AsyncSignature<Signature>::Functor(function, this);
+            detail::set_functor_metatable(luaState);
+
+#if LUA_VERSION_NUM <= 501
+            lua_call(luaState, 1, 1);
+#endif
+            lua_setglobal(luaState, name);
+        }
+
+        /// Starts coroutine which can call asynchronous functions. Coroutine runs until it calls asynchronous function
+        /// or finishes.
+        ///
+        /// @param function Lua function, for example state["handleRequest"]
+        /// @param args     Arguments of function
+        ///
+        /// @throws lua::RuntimeError   When there is runtime error in coroutine
+        template <typename ... Ts>
+        void spawn(const Value& function, Ts... args) {
+            std::unique_ptr<Coroutine> coroutine(new Coroutine(function));
+            lua_State* thread = coroutine->getThread();
+            _coroutines[thread] = std::move(coroutine);
+
+            resume(thread, [args...](Coroutine& coroutine) { return coroutine.resume(args...); });
+        }
+
+        /// Resumes coroutines with finished asynchronous operations and coroutines which yielded. Doesn't wait.
+        ///
+        /// @throws lua::RuntimeError   When there is runtime error in coroutine, coroutine is then removed
+        ///
+        /// @return Number of resumed coroutines
+        size_t poll() {
+            size_t resumed = 0;
+
+            std::vector<lua_State*> ready;
+            ready.swap(_ready);
+            for (size_t i = 0; i < ready.size(); ++i) {
+                ++resumed;
+                try {
+                    resume(ready[i], [](Coroutine& coroutine) { return coroutine.resume(); });
+                } catch (...) {
+                    // Rest of coroutines is resumed in next poll
+                    _ready.insert(_ready.begin(), ready.begin() + i + 1, ready.end());
+                    throw;
+                }
+            }
+
+            detail::AsyncResult result;
+            while (_queue->results.pop(result)) {
+                ++resumed;
+                _waiting.erase(result.thread);
+                resume(result.thread, result.resume);
+            }
+            return resumed;
+        }
+
+        /// Runs until all coroutines are finished. Waits for asynchronous results, when no coroutine can be resumed.
+        ///
+        /// @throws lua::RuntimeError   When there is runtime error in coroutine, run can be called again
+        void run() {
+            while (!_coroutines.empty()) {
+                if (poll() > 0)
+                    continue;
+
+                // Completions check sleeping flag after push, so queue must be checked again after flag is set
+                std::unique_lock<std::mutex> lock(_queue->mutex);
+                _queue->sleeping.store(true);
+                _queue->condition.wait(lock, [this]() { return !_queue->results.empty(); });
+                _queue->sleeping.store(false);
+            }
+        }
+
+        /// @return Number of coroutines which are not finished
+        size_t size() const { return _coroutines.size(); }
+
+        /// @return Number of coroutines waiting for asynchronous results
+        size_t waiting() const { return _waiting.size(); }
+    };
+
+    namespace detail {
+
+        inline std::shared_ptr<AsyncCall> begin_async_call(EventLoop* loop, lua_State* luaState) {
+            if (loop->_coroutines.count(luaState) == 0)
+                return nullptr;
+
+            loop->_waiting.insert(luaState);
+            return std::make_shared<AsyncCall>(loop->_queue, luaState);
+        }
+    }
+}
@@ -0,0 +1,298 @@
+//
+//  LuaBuffer.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+namespace lua {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// View of external memory, which is pushed to Lua as userdata without copying. Scripts can use methods len,
+    /// sub, byte, find and tostring, only tostring copies data to Lua string. Views created by sub share memory
+    /// with their buffer and release function is called when last of them is destroyed.
+    class Buffer
+    {
+    public:
+
+        /// Called when memory is not used by any buffer
+        typedef std::function<void()> ReleaseFunction;
+
+    private:
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        struct Storage
+        {
+            ReleaseFunction release;
+
+            Storage(const ReleaseFunction& release) : release(release) {}
+
+            ~Storage() {
+                if (release)
+                    release();
+            }
+        };
+
+        std::shared_ptr<Storage> _storage;
+        const char* _data;
+        size_t _size;
+
+        static const char* metatableName() { return "lua::Buffer"; }
+
+        static Buffer& self(lua_State* luaState) {
+            return *static_cast<Buffer*>(luaL_checkudata(luaState, 1, metatableName()));
+        }
+
+        /// Converts string.sub like indexes to range, negative indexes are counted from end
+        ///
+        /// @return false when range is empty
+        static bool range(lua_State* luaState, int firstIndex, int lastIndex, lua_Integer lastDefault, size_t size, size_t& first, size_t& last) {
+            lua_Integer begin = luaL_optinteger(luaState, firstIndex, 1);
+            lua_Integer end = luaL_optinteger(luaState, lastIndex, lastDefault);
+
+            if (begin < 0)
+                begin += static_cast<lua_Integer>(size) + 1;
+            if (end < 0)
+                end += static_cast<lua_Integer>(size) + 1;
+            if (begin < 1)
+                begin = 1;
+            if (end > static_cast<lua_Integer>(size))
+                end = static_cast<lua_Integer>(size);
+
+            if (begin > end)
+                return false;
+
+            first = static_cast<size_t>(begin - 1);
+            last = static_cast<size_t>(end);
+            return true;
+        }
+
+        static int lenFunction(lua_State* luaState) {
+            lua_pushnumber(luaState, static_cast<lua_Number>(self(luaState)._size));
+            return 1;
+        }
+
+        static int subFunction(lua_State* luaState) {
+            Buffer& buffer = self(luaState);
+
+            size_t first, last;
+            if (!range(luaState, 2, 3, -1, buffer._size, first, last))
+                first = last = 0;
+
+            buffer.sub(first, last - first).push(luaState);
+            return 1;
+        }
+
+        static int byteFunction(lua_State* luaState) {
+            Buffer& buffer = self(luaState);
+
+            size_t first, last;
+            if (!range(luaState, 2, 3, luaL_optinteger(luaState, 2, 1), buffer._size, first, last))
+                return 0;
+
+            int count = static_cast<int>(last - first);
+            luaL_checkstack(luaState, count, "string slice too long");
+            for (size_t i = first; i < last; ++i)
+                lua_pushinteger(luaState, static_cast<unsigned char>(buffer._data[i]));
+            return count;
+        }
+
+        static int findFunction(lua_State* luaState) {
+            Buffer& buffer = self(luaState);
+
+            size_t length;
+            const char* needle;
+            if (check(luaState, 2)) {
+                Buffer& other = *static_cast<Buffer*>(lua_touserdata(luaState, 2));
+                needle = other._data;
+                length = other._size;
+            }
+            else
+                needle = luaL_checklstring(luaState, 2, &length);
+
+            lua_Integer init = luaL_optinteger(luaState, 3, 1);
+            if (init < 0)
+                init += static_cast<lua_Integer>(buffer._size) + 1;
+            if (init < 1)
+                init = 1;
+            if (init > static_cast<lua_Integer>(buffer._size) + 1) {
+                lua_pushnil(luaState);
+                return 1;
+            }
+
+            const char* found = search(buffer._data + init - 1, buffer._data + buffer._size, needle, length);
+            if (found == nullptr) {
+                lua_pushnil(luaState);
+                return 1;
+            }
+
+            lua_pushinteger(luaState, static_cast<lua_Integer>(found - buffer._data) + 1);
+            lua_pushinteger(luaState, static_cast<lua_Integer>(found - buffer._data + length));
+            return 2;
+        }
+
+        static int tostringFunction(lua_State* luaState) {
+            Buffer& buffer = self(luaState);
+
+            size_t first, last;
+            if (!range(luaState, 2, 3, -1, buffer._size, first, last))
+                first = last = 0;
+
+            lua_pushlstring(luaState, buffer._data + first, last - first);
+            return 1;
+        }
+
+        static int gcFunction(lua_State* luaState) {
+            self(luaState).~Buffer();
+            return 0;
+        }
+
+        /// Pushes metatable, which is created on first use
+        static void pushMetatable(lua_State* luaState) {
+            if (luaL_newmetatable(luaState, metatableName()) == 0)
+                return;
+
+            // Methods are in separate table, so scripts can't call metamethods like __gc
+            static const luaL_Reg methods[] = {
+                { "len", &lenFunction },
+                { "sub", &subFunction },
+                { "byte", &byteFunction },
+                { "find", &findFunction },
+                { "tostring", &tostringFunction },
+            };
+            lua_createtable(luaState, 0, sizeof(methods) / sizeof(methods[0]));
+            for (const luaL_Reg& method : methods) {
+                lua_pushcfunction(luaState, method.func);
+                lua_setfield(luaState, -2, method.name);
+            }
+            lua_setfield(luaState, -2, "__index");
+
+            static const luaL_Reg metamethods[] = {
+                { "__len", &lenFunction },
+                { "__gc", &gcFunction },
+            };
+            for (const luaL_Reg& metamethod : metamethods) {
+                lua_pushcfunction(luaState, metamethod.func);
+                lua_setfield(luaState, -2, metamethod.name);
+            }
+
+            lua_pushstring(luaState, metatableName());
+            lua_setfield(luaState, -2, "__metatable");
+        }
+
+    public:
+
+        /// Plain search of needle, first bytes are found with memchr
+        ///
+        /// @return Start of needle or nullptr
+        static const char* search(const char* begin, const char* end, const char* needle, size_t length) {
+            if (length == 0)
+                return begin;
+
+            while (static_cast<size_t>(end - begin) >= length) {
+                const char* found = static_cast<const char*>(memchr(begin, needle[0], (end - begin) - length + 1));
+                if (found == nullptr)
+                    return nullptr;
+                if (memcmp(found + 1, needle + 1, length - 1) == 0)
+                    return found;
+                begin = found + 1;
+            }
+            return nullptr;
+        }
+
+        /// Empty buffer
+        Buffer()
+        : _data(nullptr)
+        , _size(0)
+        {
+        }
+
+        /// Wraps external memory, it must be valid until release function is called
+        ///
+        /// @param data     Data of buffer
+        /// @param size     Size of data
+        /// @param release  Called when buffer and all its views are destroyed, for example in garbage collection
+        Buffer(const char* data, size_t size, const ReleaseFunction& release = ReleaseFunction())
+        : _storage(std::make_shared<Storage>(release))
+        , _data(data)
+        , _size(size)
+        {
+        }
+
+        /// Takes string, which is destroyed with last view
+        explicit Buffer(std::string&& string)
+        : _data(nullptr)
+        , _size(string.size())
+        {
+            std::string* owned = new std::string(std::move(string));
+            _storage = std::make_shared<Storage>([owned]() { delete owned; });
+            _data = owned->data();
+        }
+
+        /// @return Data of buffer
+        const char* data() const { return _data; }
+
+        /// @return Size of data
+        size_t size() const { return _size; }
+
+        /// Creates view of part of buffer without copying
+        ///
+        /// @param offset   Start of view, it is clamped to size
+        /// @param length   Length of view, it is clamped to end
+        Buffer sub(size_t offset, size_t length) const {
+            Buffer view(*this);
+            view._data = _data + (offset < _size ? offset : _size);
+            view._size = length < _size - (view._data - _data) ? length : _size - (view._data - _data);
+            return view;
+        }
+
+        /// Pushes buffer as userdata, buffer data are not copied
+        void push(lua_State* luaState) const {
+            void* userdata = lua_newuserdata(luaState, sizeof(Buffer));
+            new (userdata) Buffer(*this);
+
+            pushMetatable(luaState);
+            lua_setmetatable(luaState, -2);
+        }
+
+        /// @return true when value is buffer userdata
+        static bool check(lua_State* luaState, int index) {
+            if (!lua_isuserdata(luaState, index) || !lua_getmetatable(luaState, index))
+                return false;
+
+            luaL_getmetatable(luaState, metatableName());
+            bool equal = lua_rawequal(luaState, -1, -2) != 0;
+            lua_pop(luaState, 2);
+            return equal;
+        }
+    };
+
+    namespace stack {
+
+        template<>
+        inline int push(lua_State* luaState, lua::Buffer value) {
+            LUASTATE_DEBUG_LOG("  PUSH  buffer %lu", static_cast<unsigned long>(value.size()));
+            value.push(luaState);
+            return 1;
+        }
+
+        template<>
+        inline bool check<lua::Buffer>(lua_State* luaState, int index) {
+            return lua::Buffer::check(luaState, index);
+        }
+
+        /// Reads view of buffer, string values are copied to new buffer
+        template<>
+        inline lua::Buffer read(lua_State* luaState, int index) {
+            if (lua::Buffer::check(luaState, index))
+                return *static_cast<lua::Buffer*>(lua_touserdata(luaState, index));
+
+            size_t length;
+            const char* string = lua_tolstring(luaState, index, &length);
+            return string != nullptr ? lua::Buffer(std::string(string, length)) : lua::Buffer();
+        }
+    }
+}
@@ -0,0 +1,166 @@
+//
+//  LuaCoroutine.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+namespace lua {
+
+    namespace detail {
+
+        /// Resumes Lua thread with arguments on its stack
+        ///
+        /// @param from         Thread which resumes coroutine
+        /// @param results      Number of yielded or returned values on top of thread stack
+        ///
+        /// @return Status of lua_resume
+        inline int resume_thread(lua_State* thread, lua_State* from, int arguments, int& results) {
+#if LUA_VERSION_NUM >= 504
+            return lua_resume(thread, from, arguments, &results);
+#elif LUA_VERSION_NUM > 501
+            int status = lua_resume(thread, from, arguments);
+            results = lua_gettop(thread);
+            return status;
+#else
+            (void)from;
+            int status = lua_resume(thread, arguments);
+            results = lua_gettop(thread);
+            return status;
+#endif
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Lua thread created in existing state. Coroutines share heap and bindings of their state, so thousands of
+    /// them are much cheaper than thousands of lua::State instances. Thread is pinned in registry until coroutine is
+    /// destroyed.
+    class Coroutine
+    {
+    public:
+
+        /// Same statuses as coroutine.status function returns
+        enum Status {
+            Suspended,  ///< Not started yet or yielded
+            Normal,     ///< Resumed and it is resuming other coroutine or calling C++ function
+            Dead,       ///< Finished or failed with error
+        };
+
+    private:
+
+        lua_State* _luaState;
+        detail::DeallocQueue* _deallocQueue;
+
+        lua_State* _thread;
+
+        /// Key of thread in LUA_REGISTRYINDEX
+        int _threadRef;
+
+        /// Set when coroutine failed with error
+        bool _failed;
+
+    public:
+
+        /// Creates coroutine which will call given function
+        ///
+        /// @param function Lua function or callable value, for example state["update"]
+        Coroutine(const Value& function)
+        : _luaState(function._stack->state)
+        , _deallocQueue(function._stack->deallocQueue)
+        , _failed(false)
+        {
+            _thread = lua_newthread(_luaState);
+            _threadRef = luaL_ref(_luaState, LUA_REGISTRYINDEX);
+
+            lua_pushvalue(_luaState, function._stack->top + function._stack->pushed - function._stack->grouped);
+            lua_xmove(_luaState, _thread, 1);
+        }
+
+        Coroutine(Coroutine&& other)
+        : _luaState(other._luaState)
+        , _deallocQueue(other._deallocQueue)
+        , _thread(other._thread)
+        , _threadRef(other._threadRef)
+        , _failed(other._failed)
+        {
+            other._luaState = nullptr;
+        }
+
+        ~Coroutine() {
+            if (_luaState != nullptr)
+                luaL_unref(_luaState, LUA_REGISTRYINDEX, _threadRef);
+        }
+
+        // Coroutine is non-copyable
+        Coroutine(const Coroutine& other) = delete;
+        Coroutine& operator=(const Coroutine&) = delete;
+
+        /// Starts or continues coroutine. Arguments of first resume are passed to function, arguments of next resumes
+        /// are returned from coroutine.yield.
+        ///
+        /// @throws lua::RuntimeError   When coroutine is not suspended or there is runtime error in coroutine
+        ///
+        /// @return Yielded or returned values moved to stack of state
+        template<typename ... Ts>
+        Value resume(Ts... args) {
+            Status current = status();
+            if (current != Suspended) {
+                if (current == Dead)
+                    lua_pushliteral(_luaState, "cannot resume dead coroutine");
+                else
+                    lua_pushliteral(_luaState, "cannot resume non-suspended coroutine");
+                throw RuntimeError(_luaState);
+            }
+
+            stack::push(_thread, args...);
+
+            int results;
+            detail::WatchdogScope watchdogScope(_luaState);
+            int status = detail::resume_thread(_thread, _luaState, sizeof...(Ts), results);
+
+            if (status != 0 && status != LUA_YIELD) {
+                _failed = true;
+
+                // Error message is moved to state, so it can be popped by exception
+                lua_xmove(_thread, _luaState, 1);
+                detail::throw_call_error(_luaState, status);
+            }
+
+            int stackTop = stack::top(_luaState);
+            lua_checkstack(_luaState, results);
+            lua_xmove(_thread, _luaState, results);
+
+            return Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, stackTop, results, results > 0 ? results - 1 : 0));
+        }
+
+        /// @return Status of coroutine
+        Status status() const {
+            if (_failed)
+                return Dead;
+
+            switch (lua_status(_thread)) {
+                case LUA_YIELD:
+                    return Suspended;
+
+                case 0: {
+                    lua_Debug debug;
+                    if (lua_getstack(_thread, 0, &debug) > 0)
+                        return Normal;
+
+                    // Function is on stack until coroutine is started
+                    return lua_gettop(_thread) == 0 ? Dead : Suspended;
+                }
+
+                default:
+                    return Dead;
+            }
+        }
+
+        /// @return true when coroutine can be resumed
+        bool isResumable() const { return status() == Suspended; }
+
+        /// @return Lua thread of coroutine
+        lua_State* getThread() const { return _thread; }
+    };
+}
@@ -0,0 +1,148 @@
+//
+//  LuaEnvironment.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+namespace lua {
+
+    namespace detail {
+
+        /// Key of shared environment metatable in LUA_REGISTRYINDEX
+        inline void* environment_metatable_key() {
+            static const char key = 0;
+            return const_cast<char*>(&key);
+        }
+
+        /// Pushes metatable of environments. It is created once per state, so environment costs only its table.
+        inline void push_environment_metatable(lua_State* luaState) {
+            lua_pushlightuserdata(luaState, environment_metatable_key());
+            lua_rawget(luaState, LUA_REGISTRYINDEX);
+            if (!lua_isnil(luaState, -1))
+                return;
+
+            lua_pop(luaState, 1);
+            lua_createtable(luaState, 0, 2);
+
+            // Missing globals are read from shared globals table
+#if LUA_VERSION_NUM > 501
+            lua_rawgeti(luaState, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+            lua_pushvalue(luaState, LUA_GLOBALSINDEX);
+#endif
+            lua_setfield(luaState, -2, "__index");
+
+            // Script can't get metatable and change shared globals through it
+            lua_pushboolean(luaState, 0);
+            lua_setfield(luaState, -2, "__metatable");
+
+            lua_pushlightuserdata(luaState, environment_metatable_key());
+            lua_pushvalue(luaState, -2);
+            lua_rawset(luaState, LUA_REGISTRYINDEX);
+        }
+
+        /// Sets environment table on top of stack to loaded chunk and pops it
+        ///
+        /// @param functionIndex    Absolute index of loaded chunk
+        inline void set_environment(lua_State* luaState, int functionIndex) {
+#if LUA_VERSION_NUM > 501
+            // First upvalue of main chunk is always _ENV
+            if (lua_setupvalue(luaState, functionIndex, 1) == nullptr)
+                lua_pop(luaState, 1);
+#else
+            lua_setfenv(luaState, functionIndex);
+#endif
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Globals table of one tenant inside shared state. Globals set by scripts running in environment stay in its
+    /// table, missing globals are read from globals of state, so all environments share bindings and libraries.
+    /// Environment is created by State::createEnvironment and used with doString, doFile and compile functions.
+    ///
+    /// @note Only globals table is separated, tables reachable from shared globals (for example string library) can
+    /// still be modified by scripts.
+    class Environment
+    {
+        friend class State;
+
+        lua_State* _luaState;
+        detail::DeallocQueue* _deallocQueue;
+
+        /// Key of globals table in LUA_REGISTRYINDEX
+        int _tableRef;
+
+        Environment(lua_State* luaState, detail::DeallocQueue* deallocQueue)
+        : _luaState(luaState)
+        , _deallocQueue(deallocQueue)
+        {
+            lua_newtable(luaState);
+
+            // _G of tenant is its own table, not shared globals
+            lua_pushvalue(luaState, -1);
+            lua_setfield(luaState, -2, "_G");
+
+            detail::push_environment_metatable(luaState);
+            lua_setmetatable(luaState, -2);
+
+            _tableRef = luaL_ref(luaState, LUA_REGISTRYINDEX);
+        }
+
+        void pushTable() const {
+            lua_rawgeti(_luaState, LUA_REGISTRYINDEX, _tableRef);
+        }
+
+    public:
+
+        Environment(Environment&& other)
+        : _luaState(other._luaState)
+        , _deallocQueue(other._deallocQueue)
+        , _tableRef(other._tableRef)
+        {
+            other._luaState = nullptr;
+        }
+
+        ~Environment() {
+            if (_luaState != nullptr)
+                luaL_unref(_luaState, LUA_REGISTRYINDEX, _tableRef);
+        }
+
+        // Environment is non-copyable
+        Environment(const Environment& other) = delete;
+        Environment& operator=(const Environment&) = delete;
+
+        /// Query global value of environment, shared globals are returned when environment doesn't have it
+        ///
+        /// @return Some value with type lua::Type
+        Value operator[](lua::String name) const {
+            int stackTop = stack::top(_luaState);
+
+            pushTable();
+            lua_getfield(_luaState, -1, name);
+            lua_remove(_luaState, -2);
+
+            return Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, stackTop, 1, 0));
+        }
+
+        /// Sets global value of environment, shared globals are not changed
+        ///
+        /// @param key      Stores value to environment[key]
+        /// @param value    Value witch will be stored to environment[key]
+        template<typename T>
+        void set(lua::String key, T value) const {
+            pushTable();
+            stack::push(_luaState, std::forward<T>(value));
+            lua_setfield(_luaState, -2, key);
+            lua_pop(_luaState, 1);
+        }
+
+        /// @return Globals table of environment
+        Value table() const {
+            int stackTop = stack::top(_luaState);
+            pushTable();
+            return Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, stackTop, 1, 0));
+        }
+    };
+}
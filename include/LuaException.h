@@ -10,6 +10,8 @@
 
 #include <exception>
 
+#include "./LuaWatchdog.h"
+
 namespace lua {
     
     namespace stack {
@@ -70,6 +72,46 @@ namespace lua {
         virtual const char* what() const throw() { return _message.c_str(); }
     };
 
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runtime error raised when Lua state cannot allocate memory, for example when it reaches its memory limit
+    class MemoryError: public RuntimeError
+    {
+    public:
+        MemoryError(lua_State* luaState)
+        : RuntimeError(luaState) {}
+        
+        virtual ~MemoryError() throw() {}
+    };
+    
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runtime error raised when call exceeds instruction or time budget set with State::setExecutionLimits
+    class TimeoutError: public RuntimeError
+    {
+    public:
+        TimeoutError(lua_State* luaState)
+        : RuntimeError(luaState) {}
+        
+        virtual ~TimeoutError() throw() {}
+    };
+    
+    namespace detail {
+        
+        /// Throws exception for error status returned from lua_pcall
+        inline void throw_call_error(lua_State* luaState, int status) {
+            if (status == LUA_ERRMEM)
+                throw MemoryError(luaState);
+            
+            if (has_watchdog(luaState)) {
+                Watchdog* watchdog = find_watchdog(luaState);
+                if (watchdog != nullptr && watchdog->timedOut) {
+                    watchdog->timedOut = false;
+                    throw TimeoutError(luaState);
+                }
+            }
+            throw RuntimeError(luaState);
+        }
+    }
+
     //////////////////////////////////////////////////////////////////////////////////////////////
     class TypeMismatchError : public std::exception
     {
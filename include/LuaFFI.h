@@ -0,0 +1,408 @@
+//
+//  LuaFFI.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace lua {
+
+    namespace detail {
+        namespace ffi {
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// C type names of LuaJIT FFI declarations
+            template<typename T, typename Enable = void>
+            struct type;
+
+            template<typename T>
+            struct type<T, typename std::enable_if<std::is_integral<T>::value>::type>
+            {
+                static std::string name() {
+                    return (std::is_signed<T>::value ? "int" : "uint") + std::to_string(sizeof(T) * 8) + "_t";
+                }
+            };
+
+            template<>
+            struct type<bool>
+            {
+                static std::string name() { return "bool"; }
+            };
+
+            template<>
+            struct type<char>
+            {
+                static std::string name() { return "char"; }
+            };
+
+            template<>
+            struct type<float>
+            {
+                static std::string name() { return "float"; }
+            };
+
+            template<>
+            struct type<double>
+            {
+                static std::string name() { return "double"; }
+            };
+
+            template<>
+            struct type<void>
+            {
+                static std::string name() { return "void"; }
+            };
+
+            template<typename T>
+            struct type<T*>
+            {
+                static std::string name() { return type<typename std::remove_cv<T>::type>::name() + "*"; }
+            };
+
+            /// @return Dimensions of array type like [2][3]
+            template<typename T>
+            inline std::string array_suffix() {
+                if (!std::is_array<T>::value)
+                    return std::string();
+                return "[" + std::to_string(std::extent<T>::value) + "]" + array_suffix<typename std::remove_extent<T>::type>();
+            }
+
+            /// @return Declaration of struct field, arrays of supported types can be used
+            template<typename T>
+            inline std::string field_declaration(const std::string& name) {
+                return type<typename std::remove_all_extents<T>::type>::name() + " " + name + array_suffix<T>();
+            }
+
+            inline size_t round_up(size_t value, size_t alignment) {
+                return (value + alignment - 1) / alignment * alignment;
+            }
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Value of release function, which is called when userdata is collected
+            struct Release
+            {
+                std::function<void()> function;
+
+                static const char* metatableName() { return "lua::FFIRelease"; }
+
+                static int gcFunction(lua_State* luaState) {
+                    Release* release = static_cast<Release*>(lua_touserdata(luaState, 1));
+                    if (release->function)
+                        release->function();
+                    release->~Release();
+                    return 0;
+                }
+            };
+
+            /// Module with functions of FFI structs, declared sizes are kept in sizes table
+            inline const char* module_chunk() {
+                return R"(
+                local ffi = require('ffi')
+                local sizes = {}
+                local module = { sizes = sizes }
+
+                -- Declares struct once per state, size of declared type is returned
+                function module.declare(name, declaration)
+                    if not pcall(ffi.typeof, name) then
+                        ffi.cdef(declaration)
+                    end
+                    sizes[name] = ffi.sizeof(name)
+                    return sizes[name]
+                end
+
+                -- Casts address to typed pointer, finalizer keeps anchor until pointer is collected
+                function module.pointer(typeName, address, anchor)
+                    return ffi.gc(ffi.cast(typeName, address), function() return anchor end)
+                end
+
+                package.loaded['luastate.ffi'] = module
+                return module
+                )";
+            }
+
+            /// Module is compiled once per state and kept in package.loaded
+            ///
+            /// @throws lua::RuntimeError   When FFI library is not available
+            inline Value module(State& state) {
+                Value package = state["package"];
+                if (package.is<Table>()) {
+                    Value loaded = package["loaded"]["luastate.ffi"];
+                    if (loaded.is<Table>())
+                        return loaded;
+                }
+                return state.compile(module_chunk()).call();
+            }
+        }
+    }
+
+    namespace stack {
+
+        template<>
+        inline int push(lua_State* luaState, lua::detail::ffi::Release value) {
+            LUASTATE_DEBUG_LOG("  PUSH  FFI release");
+            void* userdata = lua_newuserdata(luaState, sizeof(lua::detail::ffi::Release));
+            new (userdata) lua::detail::ffi::Release(std::move(value));
+
+            if (luaL_newmetatable(luaState, lua::detail::ffi::Release::metatableName()) != 0) {
+                lua_pushcfunction(luaState, &lua::detail::ffi::Release::gcFunction);
+                lua_setfield(luaState, -2, "__gc");
+            }
+            lua_setmetatable(luaState, -2);
+            return 1;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Layout of C++ struct for LuaJIT FFI. Fields are declared once in C++, matching ffi.cdef declaration is
+    /// generated with explicit padding, so undeclared members are kept on their offsets. Arrays of struct are
+    /// pushed as typed cdata pointers, so JIT compiled loops read and write C++ memory directly.
+    ///
+    /// @note Struct must have standard layout and its fields can be numbers, bools, pointers and their arrays
+    template<typename T>
+    class FFIStruct
+    {
+        static_assert(std::is_standard_layout<T>::value, "FFI struct must have standard layout");
+
+    public:
+
+        /// Called when pointer pushed to Lua is collected
+        typedef std::function<void()> ReleaseFunction;
+
+    private:
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        struct Field
+        {
+            std::string declaration;
+            size_t offset;
+            size_t size;
+            size_t alignment;
+
+            bool operator<(const Field& other) const { return offset < other.offset; }
+        };
+
+        std::string _name;
+        std::vector<Field> _fields;
+
+        void checkSize(int size) const {
+            if (size != static_cast<int>(sizeof(T)))
+                throw std::runtime_error("FFI type " + _name + " has different size than C++ struct");
+        }
+
+        template<typename Anchor>
+        Value pushPointer(State& state, T* data, Anchor anchor) const {
+            Value module = detail::ffi::module(state);
+            Value size = module["sizes"][_name.c_str()];
+            if (size.is<Nil>())
+                checkSize(module["declare"].call(_name, declaration()));
+            else
+                checkSize(size);
+
+            return module["pointer"].call(_name + "*", static_cast<Pointer>(data), anchor);
+        }
+
+    public:
+
+        /// @param name     Name of struct in FFI declarations
+        explicit FFIStruct(const std::string& name)
+        : _name(name)
+        {
+        }
+
+        /// Declares field of struct
+        ///
+        /// @param name     Name of field in FFI declarations
+        /// @param member   Pointer to member of struct
+        template<typename M>
+        FFIStruct& field(const std::string& name, M T::* member) {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+            T* object = reinterpret_cast<T*>(&storage);
+
+            Field field;
+            field.declaration = detail::ffi::field_declaration<M>(name);
+            field.offset = reinterpret_cast<const char*>(&(object->*member)) - reinterpret_cast<const char*>(object);
+            field.size = sizeof(M);
+            field.alignment = alignof(M);
+            _fields.push_back(field);
+            return *this;
+        }
+
+        /// @return Name of struct in FFI declarations
+        const std::string& name() const { return _name; }
+
+        /// @return Declaration for ffi.cdef function
+        std::string declaration() const {
+            std::vector<Field> fields(_fields);
+            std::stable_sort(fields.begin(), fields.end());
+
+            std::string result = "typedef struct {";
+            size_t position = 0;
+            size_t alignment = 1;
+            int paddings = 0;
+
+            for (const Field& field : fields) {
+                if (field.offset < position)
+                    throw std::logic_error("Fields of " + _name + " overlap");
+
+                if (detail::ffi::round_up(position, field.alignment) != field.offset)
+                    result += " uint8_t _padding" + std::to_string(paddings++) + "[" + std::to_string(field.offset - position) + "];";
+
+                result += " " + field.declaration + ";";
+                position = field.offset + field.size;
+                alignment = std::max(alignment, field.alignment);
+            }
+
+            // FFI aligns size by declared fields, alignment of struct can come from undeclared member
+            if (detail::ffi::round_up(position, alignment) != sizeof(T))
+                result += " uint8_t _padding" + std::to_string(paddings) + "[" + std::to_string(sizeof(T) - position) + "];";
+
+            return result + " } " + _name + ";";
+        }
+
+        /// Declares struct in FFI of state, it is declared only once
+        ///
+        /// @throws lua::RuntimeError   When FFI library is not available
+        /// @throws std::runtime_error  When declared type has different size than C++ struct
+        void declare(State& state) const {
+            checkSize(detail::ffi::module(state)["declare"].call(_name, declaration()));
+        }
+
+        /// Pushes pointer to array as cdata of type name*, scripts index it from 0 and its bounds are not checked
+        ///
+        /// @throws lua::RuntimeError   When FFI library is not available
+        /// @throws std::runtime_error  When declared type has different size than C++ struct
+        ///
+        /// @param state    State with LuaJIT FFI
+        /// @param data     Array of structs, it must be valid until release function is called
+        /// @param release  Called when pointer is collected
+        ///
+        /// @return Pointer cdata
+        Value pointer(State& state, T* data, const ReleaseFunction& release = ReleaseFunction()) const {
+            detail::ffi::Release anchor;
+            anchor.function = release;
+            return pushPointer(state, data, anchor);
+        }
+
+        /// Pushes pointer to array as cdata of type name*, referenced value is kept alive until pointer is collected
+        ///
+        /// @param state    State with LuaJIT FFI
+        /// @param data     Array of structs, it must be valid while anchor is alive
+        /// @param anchor   Value which owns memory of array, for example userdata
+        ///
+        /// @return Pointer cdata
+        Value pointer(State& state, T* data, const Ref& anchor) const {
+            return pushPointer(state, data, anchor.unref());
+        }
+    };
+
+    namespace detail {
+        namespace ffi {
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Types which are passed same way by FFI and by Functor. 64-bit integers are excluded, because FFI returns
+            /// them as cdata instead of numbers, for same reason functions can't return pointers.
+            template<typename T>
+            struct is_argument : std::integral_constant<bool,
+                std::is_same<T, float>::value || std::is_same<T, double>::value || std::is_same<T, bool>::value
+                || std::is_same<T, Pointer>::value
+                || (std::is_integral<T>::value && !std::is_same<T, char>::value && sizeof(T) <= 4)> {};
+
+            template<>
+            struct is_argument<void> : std::false_type {};
+
+            template<typename T>
+            struct is_result : std::integral_constant<bool,
+                std::is_void<T>::value || (is_argument<T>::value && !std::is_pointer<T>::value)> {};
+
+            template<typename ... Ts>
+            struct are_arguments : std::true_type {};
+
+            template<typename T, typename ... Ts>
+            struct are_arguments<T, Ts...> : std::integral_constant<bool, is_argument<T>::value && are_arguments<Ts...>::value> {};
+
+            /// Argument list of function declaration
+            template<typename ... Ts>
+            struct arguments
+            {
+                static std::string list() { return "void"; }
+            };
+
+            template<typename T>
+            struct arguments<T>
+            {
+                static std::string list() { return type<T>::name(); }
+            };
+
+            template<typename T, typename U, typename ... Ts>
+            struct arguments<T, U, Ts...>
+            {
+                static std::string list() { return type<T>::name() + ", " + arguments<U, Ts...>::list(); }
+            };
+
+            /// @return Function pointer type like double (*)(double, int32_t)
+            template<typename R, typename ... Args>
+            inline std::string function_pointer_declaration() {
+                return type<R>::name() + " (*)(" + arguments<Args...>::list() + ")";
+            }
+
+            /// Casts address to function pointer, nil is returned when FFI library is not available
+            inline const char* function_chunk() {
+                return R"(
+                local loaded, ffi = pcall(require, 'ffi')
+                if not loaded then return nil end
+                local declaration, address = ...
+                return ffi.cast(declaration, address)
+                )";
+            }
+
+            template<typename R, typename ... Args>
+            inline bool set_function(State& state, const std::string& name, R(*function)(Args...), std::true_type) {
+                Value pointer = state.compile(function_chunk()).call(function_pointer_declaration<R, Args...>(), reinterpret_cast<Pointer>(function));
+                if (pointer.is<Nil>()) {
+                    state.set(name.c_str(), function);
+                    return false;
+                }
+
+                state.set(name.c_str(), pointer);
+                return true;
+            }
+
+            template<typename Function>
+            inline bool set_function(State& state, const std::string& name, Function function, std::false_type) {
+                state.set(name.c_str(), function);
+                return false;
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets global function. In LuaJIT, function pointers taking and returning only numbers, bools and
+    /// lua::Pointer are set as FFI function pointers, so JIT compiler keeps loops calling them in traces. Other
+    /// functions and plain Lua use Functor, captureless lambdas can be converted with unary plus.
+    ///
+    /// @note Function called through FFI can't throw exceptions or raise Lua errors
+    ///
+    /// @return true when function is called through FFI
+    template<typename R, typename ... Args>
+    inline bool setFFIFunction(State& state, const std::string& name, R(*function)(Args...)) {
+        typedef std::integral_constant<bool, detail::ffi::is_result<R>::value && detail::ffi::are_arguments<Args...>::value> Compatible;
+        return detail::ffi::set_function(state, name, function, Compatible());
+    }
+
+    /// Sets function object with Functor
+    ///
+    /// @return Always false
+    template<typename Function>
+    inline bool setFFIFunction(State& state, const std::string& name, Function function) {
+        return detail::ffi::set_function(state, name, function, std::false_type());
+    }
+}
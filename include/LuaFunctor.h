@@ -80,6 +80,59 @@ namespace lua {
         }
     };
     
+    namespace detail {
+        
+        /// Sets functor metatable to userdata on top of stack. Metatable remembers, that state has functors which
+        /// must be finalized when state is closed.
+        inline void set_functor_metatable(lua_State* luaState) {
+            luaL_getmetatable(luaState, "luaL_Functor");
+            lua_pushboolean(luaState, true);
+            lua_setfield(luaState, -2, "created");
+            lua_setmetatable(luaState, -2);
+        }
+        
+        /// @return true when any functor was pushed to Lua state
+        inline bool has_functors(lua_State* luaState) {
+            luaL_getmetatable(luaState, "luaL_Functor");
+            lua_getfield(luaState, -1, "created");
+            bool created = lua_toboolean(luaState, -1) != 0;
+            lua_pop(luaState, 2);
+            return created;
+        }
+        
+        /// Finds metatables with __gc, which were created by luaL_newmetatable. Metatables are created with first
+        /// userdata of their type, so every such type is finalized without marking its pushes. Finalizers of standard
+        /// libraries are skipped, functor metatable counts only when functor was pushed.
+        ///
+        /// @return true when state must be closed to call finalizers
+        inline bool has_finalizers(lua_State* luaState) {
+            static const char* const ignored[] = { "FILE*", "_LOADLIB", "_CLIBS" };
+        
+            bool found = false;
+            lua_pushnil(luaState);
+            while (lua_next(luaState, LUA_REGISTRYINDEX) != 0) {
+                if (lua_type(luaState, -2) == LUA_TSTRING && lua_istable(luaState, -1)) {
+                    lua_pushliteral(luaState, "__gc");
+                    lua_rawget(luaState, -2);
+                    if (!lua_isnil(luaState, -1)) {
+                        const char* name = lua_tostring(luaState, -3);
+                        found = strcmp(name, "luaL_Functor") == 0 ? has_functors(luaState) : true;
+                        for (const char* library : ignored)
+                            found = found && strcmp(name, library) != 0;
+                    }
+                    lua_pop(luaState, 1);
+                }
+                lua_pop(luaState, 1);
+        
+                if (found) {
+                    lua_pop(luaState, 1);
+                    break;
+                }
+            }
+            return found;
+        }
+    }
+    
     namespace stack {
         
         template <typename Ret, typename ... Args>
@@ -87,8 +140,7 @@ namespace lua {
             BaseFunctor** udata = (BaseFunctor **)lua_newuserdata(luaState, sizeof(BaseFunctor *));
             *udata = new Functor<Ret, Args...>(function);
             
-            luaL_getmetatable(luaState, "luaL_Functor");
-            lua_setmetatable(luaState, -2);
+            detail::set_functor_metatable(luaState);
             return 1;
         }
         
@@ -97,8 +149,7 @@ namespace lua {
             BaseFunctor** udata = (BaseFunctor **)lua_newuserdata(luaState, sizeof(BaseFunctor *));
             *udata = new Functor<Ret, Args...>(function);
             
-            luaL_getmetatable(luaState, "luaL_Functor");
-            lua_setmetatable(luaState, -2);
+            detail::set_functor_metatable(luaState);
             return 1;
         }
         
@@ -0,0 +1,660 @@
+//
+//  LuaJson.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#   define LUASTATE_JSON_SSE2 1
+#endif
+
+namespace lua { namespace detail { namespace json {
+
+    /// Tables nested deeper are not parsed or written, so C stack can't overflow
+    static const int MaxDepth = 200;
+
+#ifdef LUASTATE_JSON_SSE2
+    /// @return Index of lowest set bit of non zero mask
+    inline int first_bit(unsigned mask) {
+#   if defined(__GNUC__)
+        return __builtin_ctz(mask);
+#   else
+        int index = 0;
+        while ((mask & 1) == 0) {
+            mask >>= 1;
+            ++index;
+        }
+        return index;
+#   endif
+    }
+#endif
+
+    /// @return First quote, backslash or control character or end of data
+    inline const char* find_string_special(const char* position, const char* end) {
+#ifdef LUASTATE_JSON_SSE2
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1F);
+
+        while (end - position >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+
+            // Unsigned minimum is equal to byte only for bytes lower than 0x20
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                           _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+            if (mask != 0)
+                return position + first_bit(mask);
+            position += 16;
+        }
+#endif
+        while (position < end && *position != '"' && *position != '\\' && static_cast<unsigned char>(*position) >= 0x20)
+            ++position;
+        return position;
+    }
+
+    inline bool is_whitespace(char character) {
+        return character == ' ' || character == '\n' || character == '\r' || character == '\t';
+    }
+
+    /// @return First character which is not whitespace or end of data
+    inline const char* skip_whitespace(const char* position, const char* end) {
+        // Minified JSON has no whitespace, so single characters are checked first
+        if (position == end || !is_whitespace(*position))
+            return position;
+
+#ifdef LUASTATE_JSON_SSE2
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i carriage = _mm_set1_epi8('\r');
+        const __m128i tab = _mm_set1_epi8('\t');
+
+        while (end - position >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+            __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+                                              _mm_or_si128(_mm_cmpeq_epi8(chunk, carriage), _mm_cmpeq_epi8(chunk, tab)));
+
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(whitespace)) ^ 0xFFFF;
+            if (mask != 0)
+                return position + first_bit(mask);
+            position += 16;
+        }
+#endif
+        while (position < end && is_whitespace(*position))
+            ++position;
+        return position;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Counts elements of all arrays and objects in order of their start, so parser can create tables with final
+    /// size. Scanner only follows structure, invalid documents are refused by parser.
+    inline void count_elements(const char* position, const char* end, std::vector<uint32_t>& counts) {
+        // Indexes of open containers in counts, count is increased with every comma
+        std::vector<size_t> open;
+        bool empty = false;
+
+        while (position < end) {
+            switch (*position) {
+                case '"':
+                    ++position;
+                    for (;;) {
+                        position = find_string_special(position, end);
+                        if (position >= end || *position == '"')
+                            break;
+
+                        // Escaped character and control characters are skipped
+                        position += *position == '\\' ? 2 : 1;
+                    }
+                    empty = false;
+                    break;
+
+                case '[':
+                case '{':
+                    open.push_back(counts.size());
+                    counts.push_back(1);
+                    empty = true;
+                    break;
+
+                case ']':
+                case '}':
+                    if (!open.empty()) {
+                        if (empty)
+                            counts[open.back()] = 0;
+                        open.pop_back();
+                    }
+                    empty = false;
+                    break;
+
+                case ',':
+                    if (!open.empty())
+                        ++counts[open.back()];
+                    break;
+
+                default:
+                    if (!is_whitespace(*position))
+                        empty = false;
+            }
+            ++position;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Parses JSON directly to Lua stack without intermediate document
+    class Parser
+    {
+        lua_State* _luaState;
+        const char* _begin;
+        const char* _position;
+        const char* _end;
+
+        std::vector<uint32_t> _counts;
+        size_t _nextCount;
+
+        /// Buffer for strings with escape sequences
+        std::string _unescaped;
+
+        void fail(const char* message) {
+            char text[128];
+            snprintf(text, sizeof(text), "invalid JSON at offset %lu: %s", static_cast<unsigned long>(_position - _begin), message);
+            throw std::runtime_error(text);
+        }
+
+        int nextCount() {
+            return _nextCount < _counts.size() ? static_cast<int>(_counts[_nextCount++]) : 0;
+        }
+
+        void expect(const char* literal, size_t length) {
+            if (static_cast<size_t>(_end - _position) < length || memcmp(_position, literal, length) != 0)
+                fail("invalid literal");
+            _position += length;
+        }
+
+        unsigned readHex() {
+            if (_end - _position < 4)
+                fail("invalid unicode escape");
+
+            unsigned code = 0;
+            for (int i = 0; i < 4; ++i) {
+                char character = *_position++;
+                code <<= 4;
+                if (character >= '0' && character <= '9')
+                    code |= character - '0';
+                else if (character >= 'a' && character <= 'f')
+                    code |= character - 'a' + 10;
+                else if (character >= 'A' && character <= 'F')
+                    code |= character - 'A' + 10;
+                else
+                    fail("invalid unicode escape");
+            }
+            return code;
+        }
+
+        void appendUtf8(unsigned code) {
+            if (code < 0x80)
+                _unescaped += static_cast<char>(code);
+            else if (code < 0x800) {
+                _unescaped += static_cast<char>(0xC0 | (code >> 6));
+                _unescaped += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000) {
+                _unescaped += static_cast<char>(0xE0 | (code >> 12));
+                _unescaped += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                _unescaped += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else {
+                _unescaped += static_cast<char>(0xF0 | (code >> 18));
+                _unescaped += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                _unescaped += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                _unescaped += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        void parseEscape() {
+            if (_position == _end)
+                fail("unterminated string");
+
+            char character = *_position++;
+            switch (character) {
+                case '"': _unescaped += '"'; break;
+                case '\\': _unescaped += '\\'; break;
+                case '/': _unescaped += '/'; break;
+                case 'b': _unescaped += '\b'; break;
+                case 'f': _unescaped += '\f'; break;
+                case 'n': _unescaped += '\n'; break;
+                case 'r': _unescaped += '\r'; break;
+                case 't': _unescaped += '\t'; break;
+
+                case 'u': {
+                    unsigned code = readHex();
+
+                    // Characters outside basic plane are written as surrogate pairs
+                    if (code >= 0xD800 && code <= 0xDBFF) {
+                        if (_end - _position < 2 || _position[0] != '\\' || _position[1] != 'u')
+                            fail("invalid surrogate pair");
+                        _position += 2;
+
+                        unsigned low = readHex();
+                        if (low < 0xDC00 || low > 0xDFFF)
+                            fail("invalid surrogate pair");
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(code);
+                    break;
+                }
+
+                default:
+                    fail("invalid escape sequence");
+            }
+        }
+
+        /// Pushes string, position is after opening quote
+        void parseString() {
+            const char* start = _position;
+            _position = find_string_special(_position, _end);
+
+            // Strings without escapes are pushed directly from input
+            if (_position < _end && *_position == '"') {
+                lua_pushlstring(_luaState, start, _position - start);
+                ++_position;
+                return;
+            }
+
+            _unescaped.assign(start, _position);
+            for (;;) {
+                if (_position == _end)
+                    fail("unterminated string");
+
+                char character = *_position++;
+                if (character == '"')
+                    break;
+                if (character != '\\')
+                    fail("control character in string");
+
+                parseEscape();
+
+                const char* chunk = _position;
+                _position = find_string_special(_position, _end);
+                _unescaped.append(chunk, _position);
+            }
+            lua_pushlstring(_luaState, _unescaped.data(), _unescaped.size());
+        }
+
+        void parseNumber() {
+            const char* start = _position;
+            bool negative = _position < _end && *_position == '-';
+            if (negative)
+                ++_position;
+
+            // Integers with up to 18 digits can't overflow, longer are parsed by strtod
+            int64_t integer = 0;
+            const char* digits = _position;
+            while (_position < _end && *_position >= '0' && *_position <= '9') {
+                if (_position - digits < 18)
+                    integer = integer * 10 + (*_position - '0');
+                ++_position;
+            }
+
+            size_t digitCount = _position - digits;
+            if (digitCount == 0 || (digitCount > 1 && *digits == '0'))
+                fail("invalid number");
+
+            bool fraction = _position < _end && (*_position == '.' || *_position == 'e' || *_position == 'E');
+            if (!fraction && digitCount <= 18) {
+                integer = negative ? -integer : integer;
+#if LUA_VERSION_NUM > 502
+                lua_pushinteger(_luaState, static_cast<lua_Integer>(integer));
+#else
+                lua_pushnumber(_luaState, static_cast<lua_Number>(integer));
+#endif
+                return;
+            }
+
+            if (_position < _end && *_position == '.') {
+                ++_position;
+                const char* fractionDigits = _position;
+                while (_position < _end && *_position >= '0' && *_position <= '9')
+                    ++_position;
+                if (_position == fractionDigits)
+                    fail("invalid number");
+            }
+
+            if (_position < _end && (*_position == 'e' || *_position == 'E')) {
+                ++_position;
+                if (_position < _end && (*_position == '+' || *_position == '-'))
+                    ++_position;
+                const char* exponentDigits = _position;
+                while (_position < _end && *_position >= '0' && *_position <= '9')
+                    ++_position;
+                if (_position == exponentDigits)
+                    fail("invalid number");
+            }
+
+            // Input doesn't have to be terminated, so number is copied for strtod
+            char number[64];
+            size_t length = _position - start;
+            if (length >= sizeof(number))
+                fail("number is too long");
+            memcpy(number, start, length);
+            number[length] = '\0';
+            lua_pushnumber(_luaState, static_cast<lua_Number>(strtod(number, nullptr)));
+        }
+
+        void parseArray(int depth) {
+            lua_createtable(_luaState, nextCount(), 0);
+
+            _position = skip_whitespace(_position, _end);
+            if (_position < _end && *_position == ']') {
+                ++_position;
+                return;
+            }
+
+            for (int index = 1; ; ++index) {
+                parseValue(depth + 1);
+                lua_rawseti(_luaState, -2, index);
+
+                _position = skip_whitespace(_position, _end);
+                if (_position == _end)
+                    fail("unterminated array");
+
+                char character = *_position++;
+                if (character == ']')
+                    return;
+                if (character != ',')
+                    fail("expected ',' or ']'");
+            }
+        }
+
+        void parseObject(int depth) {
+            lua_createtable(_luaState, 0, nextCount());
+
+            _position = skip_whitespace(_position, _end);
+            if (_position < _end && *_position == '}') {
+                ++_position;
+                return;
+            }
+
+            for (;;) {
+                _position = skip_whitespace(_position, _end);
+                if (_position == _end || *_position != '"')
+                    fail("expected string key");
+                ++_position;
+                parseString();
+
+                _position = skip_whitespace(_position, _end);
+                if (_position == _end || *_position != ':')
+                    fail("expected ':'");
+                ++_position;
+
+                parseValue(depth + 1);
+                lua_rawset(_luaState, -3);
+
+                _position = skip_whitespace(_position, _end);
+                if (_position == _end)
+                    fail("unterminated object");
+
+                char character = *_position++;
+                if (character == '}')
+                    return;
+                if (character != ',')
+                    fail("expected ',' or '}'");
+            }
+        }
+
+        void parseValue(int depth) {
+            if (depth > MaxDepth || !lua_checkstack(_luaState, 3))
+                throw std::overflow_error("JSON is nested too deeply");
+
+            _position = skip_whitespace(_position, _end);
+            if (_position == _end)
+                fail("unexpected end");
+
+            switch (*_position) {
+                case '{':
+                    ++_position;
+                    parseObject(depth);
+                    break;
+
+                case '[':
+                    ++_position;
+                    parseArray(depth);
+                    break;
+
+                case '"':
+                    ++_position;
+                    parseString();
+                    break;
+
+                case 't':
+                    expect("true", 4);
+                    lua_pushboolean(_luaState, 1);
+                    break;
+
+                case 'f':
+                    expect("false", 5);
+                    lua_pushboolean(_luaState, 0);
+                    break;
+
+                case 'n':
+                    expect("null", 4);
+                    lua_pushlightuserdata(_luaState, nullptr);
+                    break;
+
+                default:
+                    parseNumber();
+            }
+        }
+
+    public:
+
+        Parser(lua_State* luaState, const char* data, size_t size)
+        : _luaState(luaState)
+        , _begin(data)
+        , _position(data)
+        , _end(data + size)
+        , _nextCount(0)
+        {
+        }
+
+        /// Pushes value of whole document
+        void parse() {
+            count_elements(_begin, _end, _counts);
+
+            parseValue(0);
+            _position = skip_whitespace(_position, _end);
+            if (_position != _end)
+                fail("unexpected data after value");
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Writes values from Lua stack as JSON. Tables with keys 1..n are arrays, other tables are objects.
+    class Writer
+    {
+        lua_State* _luaState;
+        std::string& _output;
+
+        void writeString(const char* string, size_t length) {
+            static const char hex[] = "0123456789abcdef";
+            const char* end = string + length;
+
+            _output += '"';
+            for (;;) {
+                const char* special = find_string_special(string, end);
+                _output.append(string, special);
+                if (special == end)
+                    break;
+
+                unsigned char character = static_cast<unsigned char>(*special);
+                switch (character) {
+                    case '"': _output += "\\\""; break;
+                    case '\\': _output += "\\\\"; break;
+                    case '\n': _output += "\\n"; break;
+                    case '\r': _output += "\\r"; break;
+                    case '\t': _output += "\\t"; break;
+                    case '\b': _output += "\\b"; break;
+                    case '\f': _output += "\\f"; break;
+                    default: {
+                        char escape[] = { '\\', 'u', '0', '0', hex[character >> 4], hex[character & 0xF] };
+                        _output.append(escape, sizeof(escape));
+                    }
+                }
+                string = special + 1;
+            }
+            _output += '"';
+        }
+
+        void writeNumber(int index) {
+            char number[32];
+            int length;
+
+#if LUA_VERSION_NUM > 502
+            if (lua_isinteger(_luaState, index)) {
+                length = snprintf(number, sizeof(number), "%lld", static_cast<long long>(lua_tointeger(_luaState, index)));
+                _output.append(number, length);
+                return;
+            }
+#endif
+            double value = static_cast<double>(lua_tonumber(_luaState, index));
+            if (value != value || value - value != 0)
+                throw std::runtime_error("NaN and infinity can't be written to JSON");
+
+            if (value == std::floor(value) && std::fabs(value) < 1e15)
+                length = snprintf(number, sizeof(number), "%lld", static_cast<long long>(value));
+            else
+                length = snprintf(number, sizeof(number), "%.17g", value);
+            _output.append(number, length);
+        }
+
+        /// @return Length of array or -1 when table is object
+        int arrayLength(int index) {
+#if LUA_VERSION_NUM > 501
+            size_t length = lua_rawlen(_luaState, index);
+#else
+            size_t length = lua_objlen(_luaState, index);
+#endif
+            size_t count = 0;
+            lua_pushnil(_luaState);
+            while (lua_next(_luaState, index)) {
+                lua_pop(_luaState, 1);
+                if (++count > length) {
+                    lua_pop(_luaState, 1);
+                    return -1;
+                }
+            }
+
+            // Empty table is written as empty object
+            return length > 0 && count == length ? static_cast<int>(length) : -1;
+        }
+
+        void writeTable(int index, int depth) {
+            int length = arrayLength(index);
+            if (length >= 0) {
+                _output += '[';
+                for (int i = 1; i <= length; ++i) {
+                    if (i > 1)
+                        _output += ',';
+                    lua_rawgeti(_luaState, index, i);
+                    write(lua_gettop(_luaState), depth + 1);
+                    lua_pop(_luaState, 1);
+                }
+                _output += ']';
+                return;
+            }
+
+            _output += '{';
+            bool first = true;
+            lua_pushnil(_luaState);
+            while (lua_next(_luaState, index)) {
+                int top = lua_gettop(_luaState);
+                if (!first)
+                    _output += ',';
+                first = false;
+
+                switch (lua_type(_luaState, top - 1)) {
+                    case LUA_TSTRING: {
+                        size_t keyLength;
+                        const char* key = lua_tolstring(_luaState, top - 1, &keyLength);
+                        writeString(key, keyLength);
+                        break;
+                    }
+
+                    case LUA_TNUMBER:
+                        // Key is converted on copy, because lua_next needs original key
+                        _output += '"';
+                        writeNumber(top - 1);
+                        _output += '"';
+                        break;
+
+                    default:
+                        throw TypeMismatchError(_luaState, top - 1);
+                }
+
+                _output += ':';
+                write(top, depth + 1);
+                lua_pop(_luaState, 1);
+            }
+            _output += '}';
+        }
+
+    public:
+
+        Writer(lua_State* luaState, std::string& output)
+        : _luaState(luaState)
+        , _output(output)
+        {
+        }
+
+        /// @param index    Absolute index of value
+        void write(int index, int depth = 0) {
+            switch (lua_type(_luaState, index)) {
+                case LUA_TNIL:
+                    _output += "null";
+                    break;
+
+                case LUA_TBOOLEAN:
+                    _output += lua_toboolean(_luaState, index) ? "true" : "false";
+                    break;
+
+                case LUA_TNUMBER:
+                    writeNumber(index);
+                    break;
+
+                case LUA_TSTRING: {
+                    size_t length;
+                    const char* string = lua_tolstring(_luaState, index, &length);
+                    writeString(string, length);
+                    break;
+                }
+
+                case LUA_TTABLE:
+                    if (depth > MaxDepth || !lua_checkstack(_luaState, 3))
+                        throw std::overflow_error("table is nested too deeply or it is cyclic");
+                    writeTable(index, depth);
+                    break;
+
+                case LUA_TLIGHTUSERDATA:
+                    if (lua_touserdata(_luaState, index) == nullptr) {
+                        _output += "null";
+                        break;
+                    }
+                    throw TypeMismatchError(_luaState, index);
+
+                default:
+                    throw TypeMismatchError(_luaState, index);
+            }
+        }
+    };
+} } }
@@ -0,0 +1,189 @@
+//
+//  LuaLibraries.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+namespace lua {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Standard libraries which can be opened in lua::State. Flags can be combined with | operator.
+    /// Libraries which are not available in used Lua version are ignored.
+    namespace lib {
+        enum Library : unsigned {
+            None        = 0,
+            Base        = 1 << 0,
+            Package     = 1 << 1,
+            Coroutine   = 1 << 2,   ///< Part of base library in Lua 5.1
+            String      = 1 << 3,
+            Table       = 1 << 4,
+            Math        = 1 << 5,
+            IO          = 1 << 6,
+            OS          = 1 << 7,
+            Debug       = 1 << 8,
+            Bit         = 1 << 9,   ///< bit32 in Lua 5.2, bit in LuaJIT
+            Utf8        = 1 << 10,  ///< Lua 5.3+
+            JIT         = 1 << 11,  ///< LuaJIT only
+            FFI         = 1 << 12,  ///< LuaJIT only
+            All         = ~0u,
+        };
+    }
+
+    namespace detail {
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        struct LibraryInfo {
+            unsigned flag;
+            const char* name;
+            lua_CFunction open;
+        };
+
+        /// @return Libraries available in used Lua version terminated with empty item
+        inline const LibraryInfo* libraries() {
+            static const LibraryInfo libraries[] = {
+#if LUA_VERSION_NUM > 501
+                { lib::Base,        "_G",               &luaopen_base },
+                { lib::Coroutine,   LUA_COLIBNAME,      &luaopen_coroutine },
+#else
+                { lib::Base,        "",                 &luaopen_base },
+#endif
+                { lib::Package,     LUA_LOADLIBNAME,    &luaopen_package },
+                { lib::String,      LUA_STRLIBNAME,     &luaopen_string },
+                { lib::Table,       LUA_TABLIBNAME,     &luaopen_table },
+                { lib::Math,        LUA_MATHLIBNAME,    &luaopen_math },
+                { lib::IO,          LUA_IOLIBNAME,      &luaopen_io },
+                { lib::OS,          LUA_OSLIBNAME,      &luaopen_os },
+                { lib::Debug,       LUA_DBLIBNAME,      &luaopen_debug },
+#if defined(LUA_JITLIBNAME)
+                { lib::Bit,         LUA_BITLIBNAME,     &luaopen_bit },
+                { lib::JIT,         LUA_JITLIBNAME,     &luaopen_jit },
+                { lib::FFI,         LUA_FFILIBNAME,     &luaopen_ffi },
+#elif defined(LUA_BITLIBNAME) && LUA_VERSION_NUM == 502
+                { lib::Bit,         LUA_BITLIBNAME,     &luaopen_bit32 },
+#endif
+#if defined(LUA_UTF8LIBNAME)
+                { lib::Utf8,        LUA_UTF8LIBNAME,    &luaopen_utf8 },
+#endif
+                { lib::None,        nullptr,            nullptr },
+            };
+            return libraries;
+        }
+
+        /// Opens single library same way as luaL_openlibs does
+        inline void open_library(lua_State* luaState, const LibraryInfo& library) {
+#if LUA_VERSION_NUM > 501
+            luaL_requiref(luaState, library.name, library.open, 1);
+            lua_pop(luaState, 1);
+#else
+            lua_pushcfunction(luaState, library.open);
+            lua_pushstring(luaState, library.name);
+            lua_call(luaState, 1, 0);
+#endif
+        }
+
+        /// Finds library which creates global value with given name
+        inline const LibraryInfo* find_library(const char* name, unsigned libraries) {
+            // Package library creates also global functions
+            if (strcmp(name, "require") == 0 || strcmp(name, "module") == 0)
+                name = LUA_LOADLIBNAME;
+
+            for (const LibraryInfo* library = detail::libraries(); library->name != nullptr; ++library) {
+                if ((library->flag & libraries) != 0 && library->flag != lib::Base && strcmp(library->name, name) == 0)
+                    return library;
+            }
+            return nullptr;
+        }
+
+        /// Opens library and does additional set up of Lua state
+        ///
+        /// @param archives     Archives which will be searched by require function
+        inline void open_library(lua_State* luaState, const LibraryInfo& library, const std::vector<const ScriptArchive*>* archives) {
+            open_library(luaState, library);
+
+            if (library.flag == lib::Package)
+                install_archive_searcher(luaState, archives);
+        }
+
+        /// Function for _G metatable "__index" field. It opens library when its global value is accessed first time.
+        /// Upvalues are flags of lazy loaded libraries and pointer to archives of lua::State.
+        inline int lazyGlobalIndex(lua_State* luaState) {
+            if (lua_type(luaState, 2) != LUA_TSTRING)
+                return 0;
+
+            unsigned libraries = static_cast<unsigned>(lua_tonumber(luaState, lua_upvalueindex(1)));
+            const LibraryInfo* library = find_library(lua_tostring(luaState, 2), libraries);
+            if (library == nullptr)
+                return 0;
+
+            // Global value can be removed by user, then we will not open library again
+            lua_pushstring(luaState, library->name);
+            lua_rawget(luaState, 1);
+            bool opened = !lua_isnil(luaState, -1);
+            lua_pop(luaState, 1);
+
+            if (!opened)
+                open_library(luaState, *library, static_cast<const std::vector<const ScriptArchive*>*>(lua_touserdata(luaState, lua_upvalueindex(2))));
+
+            lua_pushvalue(luaState, 2);
+            lua_rawget(luaState, 1);
+            return 1;
+        }
+
+        /// Function for string metatable "__index" field. It opens string library when strings are indexed first
+        /// time, string library will then replace string metatable with its own.
+        inline int lazyStringIndex(lua_State* luaState) {
+            lua_getglobal(luaState, LUA_STRLIBNAME);
+            if (!lua_istable(luaState, -1))
+                return 0;
+
+            lua_pushvalue(luaState, 2);
+            lua_gettable(luaState, -2);
+            return 1;
+        }
+
+        /// Opens libraries. When lazy is set, only base library is opened and other libraries are opened when their
+        /// global values are first accessed.
+        ///
+        /// @param libraries    Flags from lua::lib namespace
+        /// @param lazy         Libraries are opened on first access
+        /// @param archives     Archives which will be searched by require function
+        inline void open_libraries(lua_State* luaState, unsigned libraries, bool lazy, const std::vector<const ScriptArchive*>* archives) {
+            if (libraries == lib::None)
+                return;
+
+            for (const LibraryInfo* library = detail::libraries(); library->name != nullptr; ++library) {
+                if ((library->flag & libraries) != 0 && (!lazy || library->flag == lib::Base))
+                    open_library(luaState, *library, archives);
+            }
+
+            if (!lazy)
+                return;
+
+            // Lazy libraries are opened from _G metatable
+#if LUA_VERSION_NUM > 501
+            lua_rawgeti(luaState, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+            lua_pushvalue(luaState, LUA_GLOBALSINDEX);
+#endif
+            lua_createtable(luaState, 0, 1);
+            lua_pushnumber(luaState, libraries & ~lib::Base);
+            lua_pushlightuserdata(luaState, const_cast<std::vector<const ScriptArchive*>*>(archives));
+            lua_pushcclosure(luaState, &lazyGlobalIndex, 2);
+            lua_setfield(luaState, -2, "__index");
+            lua_setmetatable(luaState, -2);
+            lua_pop(luaState, 1);
+
+            // Methods of strings are opened with string library
+            if ((libraries & lib::String) != 0) {
+                lua_pushliteral(luaState, "");
+                lua_createtable(luaState, 0, 1);
+                lua_pushcfunction(luaState, &lazyStringIndex);
+                lua_setfield(luaState, -2, "__index");
+                lua_setmetatable(luaState, -2);
+                lua_pop(luaState, 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,708 @@
+//
+//  LuaNumericArray.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#   define LUASTATE_NUMERIC_SSE2 1
+#endif
+
+namespace lua {
+
+    namespace detail {
+        namespace numeric {
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Conversion of array elements to and from Lua values. Sums and dot products are accumulated in
+            /// Accumulator type, so float arrays are summed in double and int32 arrays in int64.
+            template<typename T>
+            struct element;
+
+            template<>
+            struct element<float>
+            {
+                typedef double Accumulator;
+                static const char* name() { return "lua::NumericArray<float>"; }
+                static void push(lua_State* luaState, Accumulator value) { lua_pushnumber(luaState, static_cast<lua_Number>(value)); }
+                static float check(lua_State* luaState, int index) { return static_cast<float>(luaL_checknumber(luaState, index)); }
+            };
+
+            template<>
+            struct element<double>
+            {
+                typedef double Accumulator;
+                static const char* name() { return "lua::NumericArray<double>"; }
+                static void push(lua_State* luaState, Accumulator value) { lua_pushnumber(luaState, static_cast<lua_Number>(value)); }
+                static double check(lua_State* luaState, int index) { return static_cast<double>(luaL_checknumber(luaState, index)); }
+            };
+
+            template<>
+            struct element<int32_t>
+            {
+                typedef int64_t Accumulator;
+                static const char* name() { return "lua::NumericArray<int32>"; }
+                static void push(lua_State* luaState, Accumulator value) { lua_pushinteger(luaState, static_cast<lua_Integer>(value)); }
+                static int32_t check(lua_State* luaState, int index) { return static_cast<int32_t>(luaL_checkinteger(luaState, index)); }
+            };
+
+            template<>
+            struct element<int64_t>
+            {
+                typedef int64_t Accumulator;
+                static const char* name() { return "lua::NumericArray<int64>"; }
+                static void push(lua_State* luaState, Accumulator value) { lua_pushinteger(luaState, static_cast<lua_Integer>(value)); }
+                static int64_t check(lua_State* luaState, int index) { return static_cast<int64_t>(luaL_checkinteger(luaState, index)); }
+            };
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            // Operations used by map and reduce, vector versions are used for float and double arrays
+
+            struct Add
+            {
+                template<typename T> static T apply(T first, T second) { return first + second; }
+#ifdef LUASTATE_NUMERIC_SSE2
+                static __m128 apply(__m128 first, __m128 second) { return _mm_add_ps(first, second); }
+                static __m128d apply(__m128d first, __m128d second) { return _mm_add_pd(first, second); }
+#endif
+            };
+
+            struct Subtract
+            {
+                template<typename T> static T apply(T first, T second) { return first - second; }
+#ifdef LUASTATE_NUMERIC_SSE2
+                static __m128 apply(__m128 first, __m128 second) { return _mm_sub_ps(first, second); }
+                static __m128d apply(__m128d first, __m128d second) { return _mm_sub_pd(first, second); }
+#endif
+            };
+
+            struct Multiply
+            {
+                template<typename T> static T apply(T first, T second) { return first * second; }
+#ifdef LUASTATE_NUMERIC_SSE2
+                static __m128 apply(__m128 first, __m128 second) { return _mm_mul_ps(first, second); }
+                static __m128d apply(__m128d first, __m128d second) { return _mm_mul_pd(first, second); }
+#endif
+            };
+
+            struct Divide
+            {
+                template<typename T> static T apply(T first, T second) { return first / second; }
+#ifdef LUASTATE_NUMERIC_SSE2
+                static __m128 apply(__m128 first, __m128 second) { return _mm_div_ps(first, second); }
+                static __m128d apply(__m128d first, __m128d second) { return _mm_div_pd(first, second); }
+#endif
+            };
+
+            struct Min
+            {
+                template<typename T> static T apply(T first, T second) { return second < first ? second : first; }
+#ifdef LUASTATE_NUMERIC_SSE2
+                static __m128 apply(__m128 first, __m128 second) { return _mm_min_ps(first, second); }
+                static __m128d apply(__m128d first, __m128d second) { return _mm_min_pd(first, second); }
+#endif
+            };
+
+            struct Max
+            {
+                template<typename T> static T apply(T first, T second) { return second > first ? second : first; }
+#ifdef LUASTATE_NUMERIC_SSE2
+                static __m128 apply(__m128 first, __m128 second) { return _mm_max_ps(first, second); }
+                static __m128d apply(__m128d first, __m128d second) { return _mm_max_pd(first, second); }
+#endif
+            };
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Plain loops, they are used for integer arrays, where compilers vectorize them on their own, and for
+            /// remaining elements of vector kernels
+            template<typename T>
+            struct ScalarKernels
+            {
+                typedef typename element<T>::Accumulator Accumulator;
+
+                template<typename Operation>
+                static void map(T* data, size_t size, T constant) {
+                    for (size_t i = 0; i < size; ++i)
+                        data[i] = Operation::apply(data[i], constant);
+                }
+
+                /// @note Size must not be zero
+                template<typename Operation>
+                static T reduce(const T* data, size_t size) {
+                    T result = data[0];
+                    for (size_t i = 1; i < size; ++i)
+                        result = Operation::apply(result, data[i]);
+                    return result;
+                }
+
+                static void axpy(T* destination, const T* source, size_t size, T factor) {
+                    for (size_t i = 0; i < size; ++i)
+                        destination[i] += factor * source[i];
+                }
+
+                static Accumulator sum(const T* data, size_t size) {
+                    Accumulator result = 0;
+                    for (size_t i = 0; i < size; ++i)
+                        result += data[i];
+                    return result;
+                }
+
+                static Accumulator dot(const T* first, const T* second, size_t size) {
+                    Accumulator result = 0;
+                    for (size_t i = 0; i < size; ++i)
+                        result += static_cast<Accumulator>(first[i]) * second[i];
+                    return result;
+                }
+            };
+
+            template<typename T>
+            struct Kernels : ScalarKernels<T> {};
+
+#ifdef LUASTATE_NUMERIC_SSE2
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// SSE2 registers for element type, sums are always accumulated in two doubles
+            template<typename T>
+            struct Packed;
+
+            template<>
+            struct Packed<float>
+            {
+                typedef __m128 Type;
+                static const size_t width = 4;
+
+                static Type load(const float* data) { return _mm_loadu_ps(data); }
+                static void store(float* data, Type value) { _mm_storeu_ps(data, value); }
+                static Type splat(float value) { return _mm_set1_ps(value); }
+
+                static __m128d accumulate(__m128d sum, Type value) {
+                    sum = _mm_add_pd(sum, _mm_cvtps_pd(value));
+                    return _mm_add_pd(sum, _mm_cvtps_pd(_mm_movehl_ps(value, value)));
+                }
+
+                static __m128d accumulateProduct(__m128d sum, Type first, Type second) {
+                    sum = _mm_add_pd(sum, _mm_mul_pd(_mm_cvtps_pd(first), _mm_cvtps_pd(second)));
+                    return _mm_add_pd(sum, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(first, first)), _mm_cvtps_pd(_mm_movehl_ps(second, second))));
+                }
+            };
+
+            template<>
+            struct Packed<double>
+            {
+                typedef __m128d Type;
+                static const size_t width = 2;
+
+                static Type load(const double* data) { return _mm_loadu_pd(data); }
+                static void store(double* data, Type value) { _mm_storeu_pd(data, value); }
+                static Type splat(double value) { return _mm_set1_pd(value); }
+
+                static __m128d accumulate(__m128d sum, Type value) {
+                    return _mm_add_pd(sum, value);
+                }
+
+                static __m128d accumulateProduct(__m128d sum, Type first, Type second) {
+                    return _mm_add_pd(sum, _mm_mul_pd(first, second));
+                }
+            };
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Kernels processing two registers per iteration, so additions of both halves don't wait for each other
+            template<typename T>
+            struct VectorKernels : ScalarKernels<T>
+            {
+                typedef Packed<T> P;
+                typedef typename P::Type Type;
+                static const size_t step = 2 * P::width;
+
+                static double horizontal_sum(__m128d value) {
+                    double lanes[2];
+                    _mm_storeu_pd(lanes, value);
+                    return lanes[0] + lanes[1];
+                }
+
+                template<typename Operation>
+                static void map(T* data, size_t size, T constant) {
+                    Type splatted = P::splat(constant);
+                    size_t i = 0;
+                    for (; i + P::width <= size; i += P::width)
+                        P::store(data + i, Operation::apply(P::load(data + i), splatted));
+                    ScalarKernels<T>::template map<Operation>(data + i, size - i, constant);
+                }
+
+                template<typename Operation>
+                static T reduce(const T* data, size_t size) {
+                    if (size < step)
+                        return ScalarKernels<T>::template reduce<Operation>(data, size);
+
+                    Type first = P::load(data);
+                    Type second = P::load(data + P::width);
+                    size_t i = step;
+                    for (; i + step <= size; i += step) {
+                        first = Operation::apply(first, P::load(data + i));
+                        second = Operation::apply(second, P::load(data + i + P::width));
+                    }
+
+                    T lanes[P::width];
+                    P::store(lanes, Operation::apply(first, second));
+                    T result = lanes[0];
+                    for (size_t lane = 1; lane < P::width; ++lane)
+                        result = Operation::apply(result, lanes[lane]);
+                    for (; i < size; ++i)
+                        result = Operation::apply(result, data[i]);
+                    return result;
+                }
+
+                static void axpy(T* destination, const T* source, size_t size, T factor) {
+                    Type splatted = P::splat(factor);
+                    size_t i = 0;
+                    for (; i + P::width <= size; i += P::width)
+                        P::store(destination + i, Add::apply(P::load(destination + i), Multiply::apply(splatted, P::load(source + i))));
+                    ScalarKernels<T>::axpy(destination + i, source + i, size - i, factor);
+                }
+
+                static double sum(const T* data, size_t size) {
+                    __m128d first = _mm_setzero_pd();
+                    __m128d second = _mm_setzero_pd();
+                    size_t i = 0;
+                    for (; i + step <= size; i += step) {
+                        first = P::accumulate(first, P::load(data + i));
+                        second = P::accumulate(second, P::load(data + i + P::width));
+                    }
+                    return horizontal_sum(_mm_add_pd(first, second)) + ScalarKernels<T>::sum(data + i, size - i);
+                }
+
+                static double dot(const T* first, const T* second, size_t size) {
+                    __m128d firstSum = _mm_setzero_pd();
+                    __m128d secondSum = _mm_setzero_pd();
+                    size_t i = 0;
+                    for (; i + step <= size; i += step) {
+                        firstSum = P::accumulateProduct(firstSum, P::load(first + i), P::load(second + i));
+                        secondSum = P::accumulateProduct(secondSum, P::load(first + i + P::width), P::load(second + i + P::width));
+                    }
+                    return horizontal_sum(_mm_add_pd(firstSum, secondSum)) + ScalarKernels<T>::dot(first + i, second + i, size - i);
+                }
+            };
+
+            template<>
+            struct Kernels<float> : VectorKernels<float> {};
+
+            template<>
+            struct Kernels<double> : VectorKernels<double> {};
+
+#endif
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Array of float, double, int32_t or int64_t elements, which is pushed to Lua as userdata. Scripts index it
+    /// like table from 1 and can call bulk methods len, sum, min, max, scale, axpy, dot, map and totable, which run
+    /// in C++ with SSE2 for float and double arrays. Array can own its elements or wrap external memory, copies
+    /// share elements and release function is called when last of them is destroyed.
+    template<typename T>
+    class NumericArray
+    {
+    public:
+
+        /// Called when elements are not used by any array
+        typedef std::function<void()> ReleaseFunction;
+
+        /// Operations of map function
+        enum class Operation { Add, Subtract, Multiply, Divide, Min, Max };
+
+        typedef typename detail::numeric::element<T>::Accumulator Accumulator;
+
+    private:
+
+        typedef detail::numeric::element<T> Element;
+        typedef detail::numeric::Kernels<T> Kernels;
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        struct Storage
+        {
+            ReleaseFunction release;
+
+            Storage(const ReleaseFunction& release) : release(release) {}
+
+            ~Storage() {
+                if (release)
+                    release();
+            }
+        };
+
+        std::shared_ptr<Storage> _storage;
+        T* _data;
+        size_t _size;
+
+        static NumericArray& self(lua_State* luaState) {
+            return *static_cast<NumericArray*>(luaL_checkudata(luaState, 1, Element::name()));
+        }
+
+        /// @return true when signed integer minimum is divided by -1, result doesn't fit and division traps
+        bool divisionOverflows(T constant) const {
+            if (!std::numeric_limits<T>::is_integer || !std::numeric_limits<T>::is_signed || constant != static_cast<T>(-1))
+                return false;
+            return std::find(_data, _data + _size, std::numeric_limits<T>::min()) != _data + _size;
+        }
+
+        /// Metamethods get only arrays, because metatable is protected from scripts
+        static NumericArray& metamethodSelf(lua_State* luaState) {
+            return *static_cast<NumericArray*>(lua_touserdata(luaState, 1));
+        }
+
+        static int indexFunction(lua_State* luaState) {
+            NumericArray& array = metamethodSelf(luaState);
+
+            if (lua_type(luaState, 2) == LUA_TNUMBER) {
+                lua_Integer index = lua_tointeger(luaState, 2);
+                if (index >= 1 && static_cast<size_t>(index) <= array._size)
+                    Element::push(luaState, array._data[index - 1]);
+                else
+                    lua_pushnil(luaState);
+                return 1;
+            }
+
+            // Methods are in upvalue table
+            lua_pushvalue(luaState, 2);
+            lua_rawget(luaState, lua_upvalueindex(1));
+            return 1;
+        }
+
+        static int newIndexFunction(lua_State* luaState) {
+            NumericArray& array = metamethodSelf(luaState);
+
+            lua_Integer index = luaL_checkinteger(luaState, 2);
+            luaL_argcheck(luaState, index >= 1 && static_cast<size_t>(index) <= array._size, 2, "index out of range");
+            array._data[index - 1] = Element::check(luaState, 3);
+            return 0;
+        }
+
+        static int lenFunction(lua_State* luaState) {
+            lua_pushinteger(luaState, static_cast<lua_Integer>(metamethodSelf(luaState)._size));
+            return 1;
+        }
+
+        static int gcFunction(lua_State* luaState) {
+            metamethodSelf(luaState).~NumericArray();
+            return 0;
+        }
+
+        static int sizeFunction(lua_State* luaState) {
+            lua_pushinteger(luaState, static_cast<lua_Integer>(self(luaState)._size));
+            return 1;
+        }
+
+        static int sumFunction(lua_State* luaState) {
+            Element::push(luaState, self(luaState).sum());
+            return 1;
+        }
+
+        static int minFunction(lua_State* luaState) {
+            NumericArray& array = self(luaState);
+            if (array._size == 0)
+                return 0;
+
+            Element::push(luaState, array.min());
+            return 1;
+        }
+
+        static int maxFunction(lua_State* luaState) {
+            NumericArray& array = self(luaState);
+            if (array._size == 0)
+                return 0;
+
+            Element::push(luaState, array.max());
+            return 1;
+        }
+
+        static int scaleFunction(lua_State* luaState) {
+            self(luaState).scale(Element::check(luaState, 2));
+            return 0;
+        }
+
+        static int axpyFunction(lua_State* luaState) {
+            NumericArray& array = self(luaState);
+            T factor = Element::check(luaState, 2);
+            NumericArray& source = *static_cast<NumericArray*>(luaL_checkudata(luaState, 3, Element::name()));
+            luaL_argcheck(luaState, source._size == array._size, 3, "arrays have different sizes");
+
+            array.axpy(factor, source);
+            return 0;
+        }
+
+        static int dotFunction(lua_State* luaState) {
+            NumericArray& array = self(luaState);
+            NumericArray& other = *static_cast<NumericArray*>(luaL_checkudata(luaState, 2, Element::name()));
+            luaL_argcheck(luaState, other._size == array._size, 2, "arrays have different sizes");
+
+            Element::push(luaState, array.dot(other));
+            return 1;
+        }
+
+        static int mapFunction(lua_State* luaState) {
+            static const char* const operations[] = { "add", "sub", "mul", "div", "min", "max", nullptr };
+
+            NumericArray& array = self(luaState);
+            Operation operation = static_cast<Operation>(luaL_checkoption(luaState, 2, nullptr, operations));
+            T constant = Element::check(luaState, 3);
+            if (operation == Operation::Divide) {
+                luaL_argcheck(luaState, !(std::numeric_limits<T>::is_integer && constant == 0), 3, "division by zero");
+                luaL_argcheck(luaState, !array.divisionOverflows(constant), 3, "division overflow");
+            }
+
+            array.map(operation, constant);
+            return 0;
+        }
+
+        static int totableFunction(lua_State* luaState) {
+            NumericArray& array = self(luaState);
+
+            lua_createtable(luaState, static_cast<int>(array._size), 0);
+            for (size_t i = 0; i < array._size; ++i) {
+                Element::push(luaState, array._data[i]);
+                lua_rawseti(luaState, -2, static_cast<int>(i + 1));
+            }
+            return 1;
+        }
+
+        /// Pushes metatable, which is created on first use
+        static void pushMetatable(lua_State* luaState) {
+            if (luaL_newmetatable(luaState, Element::name()) == 0)
+                return;
+
+            static const luaL_Reg methods[] = {
+                { "len", &sizeFunction },
+                { "sum", &sumFunction },
+                { "min", &minFunction },
+                { "max", &maxFunction },
+                { "scale", &scaleFunction },
+                { "axpy", &axpyFunction },
+                { "dot", &dotFunction },
+                { "map", &mapFunction },
+                { "totable", &totableFunction },
+            };
+            lua_createtable(luaState, 0, sizeof(methods) / sizeof(methods[0]));
+            for (const luaL_Reg& method : methods) {
+                lua_pushcfunction(luaState, method.func);
+                lua_setfield(luaState, -2, method.name);
+            }
+            lua_pushcclosure(luaState, &indexFunction, 1);
+            lua_setfield(luaState, -2, "__index");
+
+            static const luaL_Reg metamethods[] = {
+                { "__newindex", &newIndexFunction },
+                { "__len", &lenFunction },
+                { "__gc", &gcFunction },
+            };
+            for (const luaL_Reg& metamethod : metamethods) {
+                lua_pushcfunction(luaState, metamethod.func);
+                lua_setfield(luaState, -2, metamethod.name);
+            }
+
+            lua_pushstring(luaState, Element::name());
+            lua_setfield(luaState, -2, "__metatable");
+        }
+
+    public:
+
+        /// Empty array
+        NumericArray()
+        : _data(nullptr)
+        , _size(0)
+        {
+        }
+
+        /// Array of zeros
+        explicit NumericArray(size_t size)
+        : NumericArray(std::vector<T>(size))
+        {
+        }
+
+        /// Array with copy of elements
+        explicit NumericArray(const std::vector<T>& vector)
+        : NumericArray(std::vector<T>(vector))
+        {
+        }
+
+        /// Takes vector, which is destroyed with last copy of array
+        explicit NumericArray(std::vector<T>&& vector)
+        : _data(nullptr)
+        , _size(vector.size())
+        {
+            std::vector<T>* owned = new std::vector<T>(std::move(vector));
+            _storage = std::make_shared<Storage>([owned]() { delete owned; });
+            _data = owned->data();
+        }
+
+        /// Wraps external memory, it must be valid until release function is called
+        ///
+        /// @param data     Elements of array
+        /// @param size     Count of elements
+        /// @param release  Called when array and all its copies are destroyed, for example in garbage collection
+        NumericArray(T* data, size_t size, const ReleaseFunction& release = ReleaseFunction())
+        : _storage(std::make_shared<Storage>(release))
+        , _data(data)
+        , _size(size)
+        {
+        }
+
+        /// Wraps elements of vector without copying
+        ///
+        /// @note Vector must not be resized or destroyed while scripts can use array
+        static NumericArray wrap(std::vector<T>& vector, const ReleaseFunction& release = ReleaseFunction()) {
+            return NumericArray(vector.data(), vector.size(), release);
+        }
+
+        /// @return Elements of array
+        T* data() const { return _data; }
+
+        /// @return Count of elements
+        size_t size() const { return _size; }
+
+        T& operator[](size_t index) const { return _data[index]; }
+
+        /// @return Sum of elements
+        Accumulator sum() const {
+            return Kernels::sum(_data, _size);
+        }
+
+        /// @note Array must not be empty
+        T min() const {
+            assert(_size > 0);
+            return Kernels::template reduce<detail::numeric::Min>(_data, _size);
+        }
+
+        /// @note Array must not be empty
+        T max() const {
+            assert(_size > 0);
+            return Kernels::template reduce<detail::numeric::Max>(_data, _size);
+        }
+
+        /// Multiplies all elements with factor
+        void scale(T factor) {
+            Kernels::template map<detail::numeric::Multiply>(_data, _size, factor);
+        }
+
+        /// Adds source multiplied by factor to elements
+        ///
+        /// @throws std::invalid_argument   When arrays have different sizes
+        void axpy(T factor, const NumericArray& source) {
+            if (source._size != _size)
+                throw std::invalid_argument("Arrays have different sizes");
+
+            Kernels::axpy(_data, source._data, _size, factor);
+        }
+
+        /// @return Sum of products of elements
+        ///
+        /// @throws std::invalid_argument   When arrays have different sizes
+        Accumulator dot(const NumericArray& other) const {
+            if (other._size != _size)
+                throw std::invalid_argument("Arrays have different sizes");
+
+            return Kernels::dot(_data, other._data, _size);
+        }
+
+        /// Applies operation with constant to all elements
+        ///
+        /// @throws std::invalid_argument   When integer array is divided by zero
+        /// @throws std::overflow_error     When array with minimum of signed integer type is divided by -1
+        void map(Operation operation, T constant) {
+            using namespace detail::numeric;
+            switch (operation) {
+                case Operation::Add:        Kernels::template map<Add>(_data, _size, constant); break;
+                case Operation::Subtract:   Kernels::template map<Subtract>(_data, _size, constant); break;
+                case Operation::Multiply:   Kernels::template map<Multiply>(_data, _size, constant); break;
+                case Operation::Min:        Kernels::template map<Min>(_data, _size, constant); break;
+                case Operation::Max:        Kernels::template map<Max>(_data, _size, constant); break;
+                case Operation::Divide:
+                    if (std::numeric_limits<T>::is_integer && constant == 0)
+                        throw std::invalid_argument("Division by zero");
+                    if (divisionOverflows(constant))
+                        throw std::overflow_error("Division overflow");
+                    Kernels::template map<Divide>(_data, _size, constant);
+                    break;
+            }
+        }
+
+        /// Pushes array as userdata, elements are not copied
+        void push(lua_State* luaState) const {
+            void* userdata = lua_newuserdata(luaState, sizeof(NumericArray));
+            new (userdata) NumericArray(*this);
+
+            pushMetatable(luaState);
+            lua_setmetatable(luaState, -2);
+        }
+
+        /// @return true when value is array with same element type
+        static bool check(lua_State* luaState, int index) {
+            if (!lua_isuserdata(luaState, index) || !lua_getmetatable(luaState, index))
+                return false;
+
+            luaL_getmetatable(luaState, Element::name());
+            bool equal = lua_rawequal(luaState, -1, -2) != 0;
+            lua_pop(luaState, 2);
+            return equal;
+        }
+
+        /// Reads array sharing elements, numbers from table are copied to new array
+        static NumericArray read(lua_State* luaState, int index) {
+            if (check(luaState, index))
+                return *static_cast<NumericArray*>(lua_touserdata(luaState, index));
+
+            if (!lua_istable(luaState, index))
+                return NumericArray();
+
+#if LUA_VERSION_NUM > 501
+            size_t size = lua_rawlen(luaState, index);
+#else
+            size_t size = lua_objlen(luaState, index);
+#endif
+            std::vector<T> elements(size);
+            for (size_t i = 0; i < size; ++i) {
+                lua_rawgeti(luaState, index, static_cast<int>(i + 1));
+                elements[i] = static_cast<T>(std::numeric_limits<T>::is_integer ? lua_tointeger(luaState, -1) : lua_tonumber(luaState, -1));
+                lua_pop(luaState, 1);
+            }
+            return NumericArray(std::move(elements));
+        }
+    };
+
+    namespace stack {
+
+#define LUASTATE_NUMERIC_ARRAY_STACK(T)                                                     \
+        template<>                                                                          \
+        inline int push(lua_State* luaState, lua::NumericArray<T> value) {                  \
+            LUASTATE_DEBUG_LOG("  PUSH  numeric array %lu", static_cast<unsigned long>(value.size())); \
+            value.push(luaState);                                                           \
+            return 1;                                                                       \
+        }                                                                                   \
+                                                                                            \
+        template<>                                                                          \
+        inline bool check<lua::NumericArray<T>>(lua_State* luaState, int index) {           \
+            return lua::NumericArray<T>::check(luaState, index);                            \
+        }                                                                                   \
+                                                                                            \
+        template<>                                                                          \
+        inline lua::NumericArray<T> read(lua_State* luaState, int index) {                  \
+            return lua::NumericArray<T>::read(luaState, index);                             \
+        }
+
+        LUASTATE_NUMERIC_ARRAY_STACK(float)
+        LUASTATE_NUMERIC_ARRAY_STACK(double)
+        LUASTATE_NUMERIC_ARRAY_STACK(int32_t)
+        LUASTATE_NUMERIC_ARRAY_STACK(int64_t)
+
+#undef LUASTATE_NUMERIC_ARRAY_STACK
+    }
+}
@@ -0,0 +1,95 @@
+//
+//  LuaOptions.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+namespace lua {
+    
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Options for creating lua::State
+    struct StateOptions
+    {
+        /// Standard libraries which will be opened, flags from lua::lib namespace
+        unsigned libraries;
+        
+        /// When set, only base library is opened in constructor. Other libraries are opened when their global value
+        /// is first accessed, for example string library is opened in first call of string.format or ("%d"):format
+        ///
+        /// @note Lazy loading uses metatable of _G table, so it will not work when script replaces this metatable
+        bool lazyLibraries;
+        
+        /// Custom allocation function passed to lua_newstate. When it is not set, default allocator from
+        /// luaL_newstate is used.
+        ///
+        /// @note LuaJIT on 64 bit platforms doesn't support custom allocators, default allocator is used instead
+        lua_Alloc allocator;
+        
+        /// User data passed to allocator
+        void* allocatorData;
+        
+        /// When set, lua::State creates its own lua::PoolAllocator and uses it instead of allocator
+        bool poolAllocator;
+        
+        /// Placement of memory of pool allocator. Node local placement binds heap of state to NUMA node of thread
+        /// creating the state, so create states on worker threads which will use them.
+        MemoryPlacement poolPlacement;
+        
+        /// When set, lua::State creates its own lua::ArenaAllocator and uses it instead of allocator. Memory is
+        /// released at once when state is destroyed.
+        bool arenaAllocator;
+        
+        /// When set and state uses lua::ArenaAllocator (own or given as allocator), destructor doesn't close Lua
+        /// state and only releases its arena, so no per object deallocation is done. Lua state is still closed when C++ functions were bound to it,
+        /// because their captured values must be destructed. Same applies to every userdata type with __gc in metatable
+        /// created by luaL_newmetatable, for example lua::Buffer.
+        ///
+        /// @note __gc metamethods of other objects, for example files opened by io library, are not called
+        bool fastTeardown;
+        
+        /// When set, lua::State counts allocated memory, which can be queried with State::memoryStats function. When
+        /// custom allocator can't be used, for example by LuaJIT on 64 bit platforms, only live bytes are reported.
+        bool trackMemory;
+        
+        /// Hard limit of memory allocated by lua::State in bytes. When state reaches the limit, allocations fail
+        /// and Lua raises memory error which is thrown as lua::MemoryError. Zero means no limit. When custom allocator
+        /// can't be used or limit is too small for base state, lua::State constructor throws std::runtime_error.
+        ///
+        /// @note Only calls of Lua code are protected. Allocations of other API calls from C++, for example
+        /// State::set, lua::transfer, deserialize, pushJson or StringBuilder, raise error outside of pcall when they
+        /// reach limit, so Lua panics and aborts process. Limit must leave room for values pushed from C++.
+        size_t memoryLimit;
+        
+        StateOptions()
+        : libraries(lib::All)
+        , lazyLibraries(false)
+        , allocator(nullptr)
+        , allocatorData(nullptr)
+        , poolAllocator(false)
+        , arenaAllocator(false)
+        , fastTeardown(false)
+        , trackMemory(false)
+        , memoryLimit(0)
+        {
+        }
+        
+        /// Options with given libraries
+        ///
+        /// @param libraries        Flags from lua::lib namespace
+        /// @param lazyLibraries    Libraries are opened on first access
+        StateOptions(unsigned libraries, bool lazyLibraries = false)
+        : libraries(libraries)
+        , lazyLibraries(lazyLibraries)
+        , allocator(nullptr)
+        , allocatorData(nullptr)
+        , poolAllocator(false)
+        , arenaAllocator(false)
+        , fastTeardown(false)
+        , trackMemory(false)
+        , memoryLimit(0)
+        {
+        }
+    };
+}
@@ -0,0 +1,356 @@
+//
+//  LuaProxy.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <map>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace lua {
+
+    namespace detail {
+        namespace proxy {
+
+            /// @return true when Lua value at index can be read as T, other types than numbers, bools and strings are
+            /// left to stack::read
+            template<typename T>
+            inline bool accepts(lua_State* luaState, int index) {
+                if (std::is_same<T, bool>::value)
+                    return lua_isboolean(luaState, index);
+                if (std::is_arithmetic<T>::value)
+                    return lua_type(luaState, index) == LUA_TNUMBER;
+                if (std::is_same<T, std::string>::value || std::is_same<T, const char*>::value)
+                    return lua_type(luaState, index) == LUA_TSTRING;
+                return true;
+            }
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Access to container from metamethods, key is always at index 2 and value at index 3
+            class Access
+            {
+            public:
+
+                virtual ~Access() {}
+
+                /// Pushes value of key, nil is pushed for missing key
+                virtual void index(lua_State* luaState) = 0;
+
+                /// Sets value of key
+                ///
+                /// @return Error message or nullptr
+                virtual const char* newIndex(lua_State* luaState) = 0;
+
+                /// @return Count of elements
+                virtual size_t length() const = 0;
+
+                /// Pushes key and value following key, first ones are pushed for nil
+                ///
+                /// @return Count of pushed values, zero when there are no more elements
+                virtual int next(lua_State* luaState) = 0;
+            };
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Vector is indexed from 1 and it is appended by setting index after its end
+            template<typename Vector>
+            class VectorAccess : public Access
+            {
+                typedef typename Vector::value_type Element;
+
+                Vector& _vector;
+
+            public:
+
+                explicit VectorAccess(Vector& vector) : _vector(vector) {}
+
+                void index(lua_State* luaState) override {
+                    if (lua_type(luaState, 2) == LUA_TNUMBER) {
+                        lua_Integer position = lua_tointeger(luaState, 2);
+                        if (position >= 1 && static_cast<size_t>(position) <= _vector.size()) {
+                            stack::push(luaState, _vector[position - 1]);
+                            return;
+                        }
+                    }
+                    lua_pushnil(luaState);
+                }
+
+                const char* newIndex(lua_State* luaState) override {
+                    if (lua_type(luaState, 2) != LUA_TNUMBER)
+                        return "vector index must be number";
+                    if (!accepts<Element>(luaState, 3))
+                        return "vector element has wrong type";
+
+                    lua_Integer position = lua_tointeger(luaState, 2);
+                    if (position >= 1 && static_cast<size_t>(position) <= _vector.size())
+                        _vector[position - 1] = stack::read<Element>(luaState, 3);
+                    else if (position >= 1 && static_cast<size_t>(position) == _vector.size() + 1)
+                        _vector.push_back(stack::read<Element>(luaState, 3));
+                    else
+                        return "vector index out of range";
+                    return nullptr;
+                }
+
+                size_t length() const override {
+                    return _vector.size();
+                }
+
+                int next(lua_State* luaState) override {
+                    lua_Integer position = lua_isnil(luaState, 2) ? 0 : lua_tointeger(luaState, 2);
+                    if (position < 0 || static_cast<size_t>(position) >= _vector.size())
+                        return 0;
+
+                    lua_pushinteger(luaState, position + 1);
+                    stack::push(luaState, _vector[position]);
+                    return 2;
+                }
+            };
+
+            //////////////////////////////////////////////////////////////////////////////////////////////
+            /// Map keys are iterated in order of map, setting nil erases key
+            template<typename Map, bool Ordered>
+            class MapAccess : public Access
+            {
+                typedef typename Map::key_type Key;
+                typedef typename Map::mapped_type Mapped;
+
+                Map& _map;
+
+                /// Ordered maps find following key in logarithmic time
+                typename Map::iterator following(const Key& key, std::true_type) {
+                    return _map.upper_bound(key);
+                }
+
+                /// Hash maps find key and move to next element
+                typename Map::iterator following(const Key& key, std::false_type) {
+                    typename Map::iterator iterator = _map.find(key);
+                    return iterator == _map.end() ? iterator : ++iterator;
+                }
+
+            public:
+
+                explicit MapAccess(Map& map) : _map(map) {}
+
+                void index(lua_State* luaState) override {
+                    if (accepts<Key>(luaState, 2)) {
+                        typename Map::iterator iterator = _map.find(stack::read<Key>(luaState, 2));
+                        if (iterator != _map.end()) {
+                            stack::push(luaState, iterator->second);
+                            return;
+                        }
+                    }
+                    lua_pushnil(luaState);
+                }
+
+                const char* newIndex(lua_State* luaState) override {
+                    if (!accepts<Key>(luaState, 2))
+                        return "map key has wrong type";
+
+                    if (lua_isnil(luaState, 3)) {
+                        _map.erase(stack::read<Key>(luaState, 2));
+                        return nullptr;
+                    }
+
+                    if (!accepts<Mapped>(luaState, 3))
+                        return "map value has wrong type";
+
+                    std::pair<typename Map::iterator, bool> inserted = _map.insert(std::make_pair(stack::read<Key>(luaState, 2), stack::read<Mapped>(luaState, 3)));
+                    if (!inserted.second)
+                        inserted.first->second = stack::read<Mapped>(luaState, 3);
+                    return nullptr;
+                }
+
+                size_t length() const override {
+                    return _map.size();
+                }
+
+                int next(lua_State* luaState) override {
+                    typename Map::iterator iterator = _map.end();
+                    if (lua_isnil(luaState, 2))
+                        iterator = _map.begin();
+                    else if (accepts<Key>(luaState, 2))
+                        iterator = following(stack::read<Key>(luaState, 2), std::integral_constant<bool, Ordered>());
+
+                    if (iterator == _map.end())
+                        return 0;
+
+                    stack::push(luaState, iterator->first);
+                    stack::push(luaState, iterator->second);
+                    return 2;
+                }
+            };
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Userdata giving scripts access to live std::vector, std::map or std::unordered_map. Elements are not copied
+    /// to table, only touched keys and values are converted with stack::push and stack::read, so other types than
+    /// numbers, bools and strings need their specializations. Scripts use indexing, # operator and iteration with
+    /// pairs (Lua 5.2 and newer) or by calling proxy (all versions).
+    ///
+    /// @note Vectors are indexed from 1 and setting index after end appends element. Setting nil erases map key.
+    /// Like with tables, keys can't be added or erased during iteration.
+    class Proxy
+    {
+        std::shared_ptr<detail::proxy::Access> _access;
+
+        /// Keeps shared container alive
+        std::shared_ptr<void> _owner;
+
+        static const char* metatableName() { return "lua::Proxy"; }
+
+        /// Metamethods get only proxies, because metatable is protected from scripts
+        static Proxy& self(lua_State* luaState) {
+            return *static_cast<Proxy*>(lua_touserdata(luaState, 1));
+        }
+
+        static int indexFunction(lua_State* luaState) {
+            self(luaState)._access->index(luaState);
+            return 1;
+        }
+
+        static int newIndexFunction(lua_State* luaState) {
+            const char* error = self(luaState)._access->newIndex(luaState);
+            if (error != nullptr)
+                return luaL_error(luaState, "%s", error);
+            return 0;
+        }
+
+        static int lenFunction(lua_State* luaState) {
+            lua_pushinteger(luaState, static_cast<lua_Integer>(self(luaState)._access->length()));
+            return 1;
+        }
+
+        /// Works like next function for tables
+        static int nextFunction(lua_State* luaState) {
+            Proxy& proxy = *static_cast<Proxy*>(luaL_checkudata(luaState, 1, metatableName()));
+            lua_settop(luaState, 2);
+
+            int pushed = proxy._access->next(luaState);
+            if (pushed == 0) {
+                lua_pushnil(luaState);
+                return 1;
+            }
+            return pushed;
+        }
+
+        /// Returns iterator function, proxy and first key
+        static int pairsFunction(lua_State* luaState) {
+            lua_pushcfunction(luaState, &nextFunction);
+            lua_pushvalue(luaState, 1);
+            lua_pushnil(luaState);
+            return 3;
+        }
+
+        static int gcFunction(lua_State* luaState) {
+            self(luaState).~Proxy();
+            return 0;
+        }
+
+        /// Pushes metatable, which is created on first use
+        static void pushMetatable(lua_State* luaState) {
+            if (luaL_newmetatable(luaState, metatableName()) == 0)
+                return;
+
+            static const luaL_Reg metamethods[] = {
+                { "__index", &indexFunction },
+                { "__newindex", &newIndexFunction },
+                { "__len", &lenFunction },
+                { "__pairs", &pairsFunction },
+                { "__call", &pairsFunction },
+                { "__gc", &gcFunction },
+            };
+            for (const luaL_Reg& metamethod : metamethods) {
+                lua_pushcfunction(luaState, metamethod.func);
+                lua_setfield(luaState, -2, metamethod.name);
+            }
+
+            lua_pushstring(luaState, metatableName());
+            lua_setfield(luaState, -2, "__metatable");
+        }
+
+    public:
+
+        /// Empty proxy can't be pushed
+        Proxy() {}
+
+        /// Proxy of vector, which must be valid while scripts use proxy
+        template<typename T, typename Allocator>
+        explicit Proxy(std::vector<T, Allocator>& vector)
+        : _access(std::make_shared<detail::proxy::VectorAccess<std::vector<T, Allocator>>>(vector))
+        {
+        }
+
+        /// Proxy of map, which must be valid while scripts use proxy
+        template<typename Key, typename T, typename Compare, typename Allocator>
+        explicit Proxy(std::map<Key, T, Compare, Allocator>& map)
+        : _access(std::make_shared<detail::proxy::MapAccess<std::map<Key, T, Compare, Allocator>, true>>(map))
+        {
+        }
+
+        /// Proxy of hash map, which must be valid while scripts use proxy
+        template<typename Key, typename T, typename Hash, typename Equal, typename Allocator>
+        explicit Proxy(std::unordered_map<Key, T, Hash, Equal, Allocator>& map)
+        : _access(std::make_shared<detail::proxy::MapAccess<std::unordered_map<Key, T, Hash, Equal, Allocator>, false>>(map))
+        {
+        }
+
+        /// Proxy of shared container, it is kept alive until proxy is collected
+        template<typename Container>
+        explicit Proxy(const std::shared_ptr<Container>& container)
+        : Proxy(*container)
+        {
+            _owner = container;
+        }
+
+        /// Pushes proxy as userdata
+        void push(lua_State* luaState) const {
+            assert(_access);
+
+            void* userdata = lua_newuserdata(luaState, sizeof(Proxy));
+            new (userdata) Proxy(*this);
+
+            pushMetatable(luaState);
+            lua_setmetatable(luaState, -2);
+        }
+
+        /// @return true when value is proxy userdata
+        static bool check(lua_State* luaState, int index) {
+            if (!lua_isuserdata(luaState, index) || !lua_getmetatable(luaState, index))
+                return false;
+
+            luaL_getmetatable(luaState, metatableName());
+            bool equal = lua_rawequal(luaState, -1, -2) != 0;
+            lua_pop(luaState, 2);
+            return equal;
+        }
+    };
+
+    namespace stack {
+
+        template<>
+        inline int push(lua_State* luaState, lua::Proxy value) {
+            LUASTATE_DEBUG_LOG("  PUSH  proxy");
+            value.push(luaState);
+            return 1;
+        }
+
+        template<>
+        inline bool check<lua::Proxy>(lua_State* luaState, int index) {
+            return lua::Proxy::check(luaState, index);
+        }
+
+        /// Reads proxy sharing same container, other values give empty proxy
+        template<>
+        inline lua::Proxy read(lua_State* luaState, int index) {
+            if (lua::Proxy::check(luaState, index))
+                return *static_cast<lua::Proxy*>(lua_touserdata(luaState, index));
+            return lua::Proxy();
+        }
+    }
+}
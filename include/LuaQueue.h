@@ -0,0 +1,79 @@
+//
+//  LuaQueue.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include <atomic>
+
+namespace lua {
+
+    namespace detail {
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Intrusive multi-producer single-consumer queue. Push is one atomic exchange, so producers never wait
+        /// for each other. Only one thread can pop items.
+        template <typename T>
+        class MpscQueue
+        {
+        public:
+
+            struct Node {
+                std::atomic<Node*> next;
+                T value;
+
+                Node() : next(nullptr) {}
+                Node(T&& value) : next(nullptr), value(std::move(value)) {}
+            };
+
+        private:
+
+            /// Last pushed node, producers are swapping it
+            std::atomic<Node*> _head;
+
+            /// Node before first item, it is owned by consumer
+            Node* _tail;
+
+        public:
+
+            MpscQueue() : _head(new Node()), _tail(_head.load()) {}
+
+            ~MpscQueue() {
+                T value;
+                while (pop(value));
+                delete _tail;
+            }
+
+            MpscQueue(const MpscQueue& other) = delete;
+            MpscQueue& operator=(const MpscQueue&) = delete;
+
+            /// Can be called from any thread
+            void push(T&& value) {
+                Node* node = new Node(std::move(value));
+                Node* previous = _head.exchange(node);
+                previous->next.store(node, std::memory_order_release);
+            }
+
+            /// Can be called only from consumer thread. Item which is being pushed right now may not be visible yet.
+            ///
+            /// @return false when queue is empty
+            bool pop(T& value) {
+                Node* next = _tail->next.load(std::memory_order_acquire);
+                if (next == nullptr)
+                    return false;
+
+                value = std::move(next->value);
+                delete _tail;
+                _tail = next;
+                return true;
+            }
+
+            /// @return true when there is no item, which can be popped
+            bool empty() const {
+                return _tail->next.load(std::memory_order_acquire) == nullptr && _head.load() == _tail;
+            }
+        };
+    }
+}
@@ -0,0 +1,331 @@
+//
+//  LuaScheduler.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lua {
+
+    namespace detail {
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Counts unfinished jobs of one parallel operation and keeps first thrown exception
+        class JobGroup
+        {
+            size_t _remaining;
+            std::mutex _mutex;
+            std::condition_variable _condition;
+            std::exception_ptr _error;
+
+        public:
+
+            JobGroup(size_t count) : _remaining(count) {}
+
+            void fail(std::exception_ptr error) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_error)
+                    _error = error;
+            }
+
+            bool failed() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return static_cast<bool>(_error);
+            }
+
+            /// Counter is changed under lock, so waiting thread can't destroy group before last job notifies it
+            void finish() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (--_remaining == 0)
+                    _condition.notify_all();
+            }
+
+            /// Waits for all jobs and rethrows first exception
+            void wait() {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this]() { return _remaining == 0; });
+                if (_error)
+                    std::rethrow_exception(_error);
+            }
+        };
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs independent script jobs on worker threads. Every worker owns its lua::State, which is initialized with
+    /// same routine. Jobs are distributed to per-worker deques, worker takes newest job from its own deque and when
+    /// it is empty, it steals oldest job from other workers.
+    class Scheduler
+    {
+    public:
+
+        /// Job executed on one of workers
+        typedef std::function<void(State&)> Job;
+
+        /// Routine which initializes state of every worker
+        typedef std::function<void(State&)> Initializer;
+
+    private:
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Worker>> _workers;
+
+        /// Jobs which are waiting in deques
+        std::atomic<size_t> _queued;
+
+        /// Jobs which are not finished
+        std::atomic<size_t> _pending;
+
+        /// Workers waiting for jobs
+        std::atomic<size_t> _sleeping;
+
+        std::atomic<size_t> _nextWorker;
+        std::atomic<bool> _stopping;
+
+        std::atomic<uint64_t> _executed;
+        std::atomic<uint64_t> _steals;
+
+        std::mutex _mutex;
+        std::condition_variable _wakeCondition;
+        std::condition_variable _idleCondition;
+
+        /// First exception thrown from submitted job
+        std::exception_ptr _error;
+
+        bool popOwn(size_t index, Job& job) {
+            Worker& worker = *_workers[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.jobs.empty())
+                return false;
+
+            job = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+            return true;
+        }
+
+        bool steal(size_t index, Job& job) {
+            for (size_t i = 1; i < _workers.size(); ++i) {
+                Worker& victim = *_workers[(index + i) % _workers.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.jobs.empty())
+                    continue;
+
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                _steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        void execute(State& state, Job& job) {
+            try {
+                job(state);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_error)
+                    _error = std::current_exception();
+            }
+            job = nullptr;
+            _executed.fetch_add(1, std::memory_order_relaxed);
+
+            if (_pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _idleCondition.notify_all();
+            }
+        }
+
+        void run(size_t index, const StateOptions& options, const Initializer& initializer, std::promise<void>& ready) {
+            std::unique_ptr<State> state;
+            try {
+                state.reset(new State(options));
+                if (initializer)
+                    initializer(*state);
+            } catch (...) {
+                ready.set_exception(std::current_exception());
+                return;
+            }
+            ready.set_value();
+
+            for (;;) {
+                Job job;
+                if (popOwn(index, job) || steal(index, job)) {
+                    _queued.fetch_sub(1);
+                    execute(*state, job);
+                    continue;
+                }
+
+                // Submitter checks sleeping counter after job is queued, so queue is checked again after increment
+                std::unique_lock<std::mutex> lock(_mutex);
+                _sleeping.fetch_add(1);
+                _wakeCondition.wait(lock, [this]() { return _queued.load() > 0 || _stopping.load(); });
+                _sleeping.fetch_sub(1);
+
+                if (_stopping.load() && _queued.load() == 0)
+                    break;
+            }
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping.store(true);
+            }
+            _wakeCondition.notify_all();
+
+            for (std::unique_ptr<Worker>& worker : _workers) {
+                if (worker->thread.joinable())
+                    worker->thread.join();
+            }
+        }
+
+    public:
+
+        /// Starts workers and initializes their states. Constructor waits until all states are initialized.
+        ///
+        /// @param initializer  Routine called on every worker thread after state is created
+        /// @param workerCount  Number of worker threads, zero means number of hardware threads
+        /// @param options      Options of created states
+        ///
+        /// @throws Exception thrown from initialization routine
+        Scheduler(Initializer initializer, size_t workerCount = 0, const StateOptions& options = StateOptions())
+        : _queued(0)
+        , _pending(0)
+        , _sleeping(0)
+        , _nextWorker(0)
+        , _stopping(false)
+        , _executed(0)
+        , _steals(0)
+        {
+            if (workerCount == 0)
+                workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+            for (size_t i = 0; i < workerCount; ++i)
+                _workers.emplace_back(new Worker());
+
+            std::vector<std::promise<void>> ready(workerCount);
+            for (size_t i = 0; i < workerCount; ++i)
+                _workers[i]->thread = std::thread(&Scheduler::run, this, i, options, initializer, std::ref(ready[i]));
+
+            try {
+                for (std::promise<void>& promise : ready)
+                    promise.get_future().get();
+            } catch (...) {
+                stop();
+                throw;
+            }
+        }
+
+        /// Executes all submitted jobs and stops workers
+        ~Scheduler() {
+            stop();
+        }
+
+        // Scheduler is non-copyable
+        Scheduler(const Scheduler& other) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        /// Submits job to one of workers. Can be called from any thread.
+        ///
+        /// @note Job must not keep lua::Value instances after it returns
+        void submit(Job job) {
+            _pending.fetch_add(1);
+
+            Worker& worker = *_workers[_nextWorker.fetch_add(1, std::memory_order_relaxed) % _workers.size()];
+            {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.jobs.push_back(std::move(job));
+            }
+            _queued.fetch_add(1);
+
+            if (_sleeping.load() > 0) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _wakeCondition.notify_one();
+            }
+        }
+
+        /// Waits until all submitted jobs are finished
+        ///
+        /// @throws First exception thrown from jobs since last wait
+        /// @note Must not be called from job, because worker would wait for itself
+        void wait() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _idleCondition.wait(lock, [this]() { return _pending.load() == 0; });
+
+            if (_error) {
+                std::exception_ptr error = _error;
+                _error = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+
+        /// Calls global Lua function for every input in parallel. Inputs are split to chunks, which are submitted
+        /// as jobs, results are stored in order of inputs.
+        ///
+        /// @param functionName Name of global function, which takes one input and returns one result
+        /// @param inputs       Inputs of function
+        /// @param chunkSize    Number of inputs in one job, zero means automatic size
+        ///
+        /// @return Results of function in order of inputs
+        /// @throws First exception thrown from function calls
+        /// @note Must not be called from job, because worker would wait for itself
+        template <typename R, typename T>
+        std::vector<R> parallelMap(const std::string& functionName, const std::vector<T>& inputs, size_t chunkSize = 0) {
+            // Every result is written to separate object, so std::vector<bool> can't be used
+            std::unique_ptr<R[]> results(new R[inputs.size()]);
+
+            if (chunkSize == 0)
+                chunkSize = std::max<size_t>(1, inputs.size() / (_workers.size() * 8));
+            size_t chunkCount = (inputs.size() + chunkSize - 1) / chunkSize;
+
+            detail::JobGroup group(chunkCount);
+            R* output = results.get();
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                size_t begin = chunk * chunkSize;
+                size_t end = std::min(begin + chunkSize, inputs.size());
+
+                submit([&group, &functionName, &inputs, output, begin, end](State& state) {
+                    try {
+                        if (!group.failed()) {
+                            Value function = state[functionName.c_str()];
+                            for (size_t i = begin; i < end; ++i)
+                                output[i] = function.call(inputs[i]).template to<R>();
+                        }
+                    } catch (...) {
+                        group.fail(std::current_exception());
+                    }
+                    group.finish();
+                });
+            }
+            group.wait();
+
+            return std::vector<R>(results.get(), results.get() + inputs.size());
+        }
+
+        /// @return Number of worker threads
+        size_t size() const { return _workers.size(); }
+
+        /// @return Number of executed jobs
+        uint64_t executedJobs() const { return _executed.load(std::memory_order_relaxed); }
+
+        /// @return Number of jobs which were stolen from other workers
+        uint64_t steals() const { return _steals.load(std::memory_order_relaxed); }
+    };
+}
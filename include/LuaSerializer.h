@@ -0,0 +1,436 @@
+//
+//  LuaSerializer.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lua {
+
+    /// Receives serialized data. Data are valid only during call, because buffer is reused for next data.
+    typedef std::function<void(const char* data, size_t size)> OutputFunction;
+
+    namespace detail {
+
+        /// Format of serialized values. Every value starts with tag byte, integers and lengths are varints.
+        namespace serialized {
+            static const char Magic[] = { 'L', 'S', 1 };
+
+            enum Tag : uint8_t {
+                Nil,
+                False,
+                True,
+                Integer,        ///< Zigzag varint
+                Number,         ///< 8 bytes of little endian double
+                String,         ///< Varint length and bytes, string is added to string table
+                StringRef,      ///< Varint index to string table
+                Table,          ///< Varint array count and hash count, array values and then key value pairs
+                TableRef,       ///< Varint index of table in order of their start
+            };
+
+            /// Tables nested deeper are not serialized, so C stack can't overflow
+            static const int MaxDepth = 200;
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Streaming writer to caller supplied buffer. Full buffer is passed to output function and reused.
+        class BufferWriter
+        {
+            char* _buffer;
+            size_t _size;
+            size_t _used;
+            size_t _written;
+            const OutputFunction& _output;
+
+        public:
+
+            BufferWriter(char* buffer, size_t size, const OutputFunction& output)
+            : _buffer(buffer)
+            , _size(size)
+            , _used(0)
+            , _written(0)
+            , _output(output)
+            {
+            }
+
+            void flush() {
+                if (_used > 0)
+                    _output(_buffer, _used);
+                _written += _used;
+                _used = 0;
+            }
+
+            void write(const char* data, size_t size) {
+                while (size > 0) {
+                    if (_used == _size)
+                        flush();
+
+                    size_t chunk = size < _size - _used ? size : _size - _used;
+                    memcpy(_buffer + _used, data, chunk);
+                    _used += chunk;
+                    data += chunk;
+                    size -= chunk;
+                }
+            }
+
+            void writeByte(uint8_t byte) {
+                if (_used == _size)
+                    flush();
+                _buffer[_used++] = static_cast<char>(byte);
+            }
+
+            void writeVarint(uint64_t value) {
+                while (value >= 0x80) {
+                    writeByte(static_cast<uint8_t>(value) | 0x80);
+                    value >>= 7;
+                }
+                writeByte(static_cast<uint8_t>(value));
+            }
+
+            /// @return Number of written bytes including bytes which were not flushed yet
+            size_t written() const { return _written + _used; }
+        };
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Writes values from Lua stack. Strings and tables are written once, next occurrences are written as
+        /// references to them.
+        class Serializer
+        {
+            lua_State* _luaState;
+            BufferWriter& _writer;
+
+            std::unordered_map<const void*, uint32_t> _strings;
+            std::unordered_map<const void*, uint32_t> _tables;
+
+            /// @return true when number can be written as integer and read back without change
+            static bool isInteger(lua_State* luaState, int index, int64_t& integer) {
+#if LUA_VERSION_NUM > 502
+                if (!lua_isinteger(luaState, index))
+                    return false;
+                integer = lua_tointeger(luaState, index);
+                return true;
+#else
+                // Larger doubles can't be represented exactly in other Lua versions
+                lua_Number number = lua_tonumber(luaState, index);
+                if (number != std::floor(number) || std::fabs(number) > 9007199254740992.0)
+                    return false;
+                integer = static_cast<int64_t>(number);
+                return true;
+#endif
+            }
+
+            /// @return true when key is stored in written array part
+            static bool isArrayKey(lua_State* luaState, int index, size_t arrayCount) {
+                if (lua_type(luaState, index) != LUA_TNUMBER)
+                    return false;
+
+                int64_t key;
+                return isInteger(luaState, index, key) && key >= 1 && static_cast<uint64_t>(key) <= arrayCount;
+            }
+
+            void writeNumber(int index) {
+                int64_t integer;
+                if (isInteger(_luaState, index, integer)) {
+                    _writer.writeByte(serialized::Integer);
+                    _writer.writeVarint((static_cast<uint64_t>(integer) << 1) ^ static_cast<uint64_t>(integer >> 63));
+                    return;
+                }
+
+                double number = static_cast<double>(lua_tonumber(_luaState, index));
+                uint64_t bits;
+                memcpy(&bits, &number, sizeof(bits));
+
+                char bytes[8];
+                for (int i = 0; i < 8; ++i)
+                    bytes[i] = static_cast<char>(bits >> (i * 8));
+
+                _writer.writeByte(serialized::Number);
+                _writer.write(bytes, sizeof(bytes));
+            }
+
+            void writeString(int index) {
+                size_t length;
+                const char* string = lua_tolstring(_luaState, index, &length);
+
+                // Equal short strings are same object in Lua, so pointer identifies them
+                auto inserted = _strings.insert(std::make_pair(static_cast<const void*>(string), static_cast<uint32_t>(_strings.size())));
+                if (!inserted.second) {
+                    _writer.writeByte(serialized::StringRef);
+                    _writer.writeVarint(inserted.first->second);
+                    return;
+                }
+
+                _writer.writeByte(serialized::String);
+                _writer.writeVarint(length);
+                _writer.write(string, length);
+            }
+
+            void writeTable(int index, int depth) {
+                auto inserted = _tables.insert(std::make_pair(lua_topointer(_luaState, index), static_cast<uint32_t>(_tables.size())));
+                if (!inserted.second) {
+                    _writer.writeByte(serialized::TableRef);
+                    _writer.writeVarint(inserted.first->second);
+                    return;
+                }
+
+                if (depth > serialized::MaxDepth || !lua_checkstack(_luaState, 3))
+                    throw std::overflow_error("table is nested too deeply");
+
+#if LUA_VERSION_NUM > 501
+                size_t arrayCount = lua_rawlen(_luaState, index);
+#else
+                size_t arrayCount = lua_objlen(_luaState, index);
+#endif
+
+                // Counts are written before content, so reader can create table with exact size
+                size_t hashCount = 0;
+                lua_pushnil(_luaState);
+                while (lua_next(_luaState, index)) {
+                    lua_pop(_luaState, 1);
+                    if (!isArrayKey(_luaState, -1, arrayCount))
+                        ++hashCount;
+                }
+
+                _writer.writeByte(serialized::Table);
+                _writer.writeVarint(arrayCount);
+                _writer.writeVarint(hashCount);
+
+                for (size_t i = 1; i <= arrayCount; ++i) {
+                    lua_rawgeti(_luaState, index, static_cast<int>(i));
+                    write(lua_gettop(_luaState), depth + 1);
+                    lua_pop(_luaState, 1);
+                }
+
+                lua_pushnil(_luaState);
+                while (lua_next(_luaState, index)) {
+                    int top = lua_gettop(_luaState);
+                    if (!isArrayKey(_luaState, top - 1, arrayCount)) {
+                        write(top - 1, depth + 1);
+                        write(top, depth + 1);
+                    }
+                    lua_pop(_luaState, 1);
+                }
+            }
+
+        public:
+
+            Serializer(lua_State* luaState, BufferWriter& writer)
+            : _luaState(luaState)
+            , _writer(writer)
+            {
+            }
+
+            /// @param index    Absolute index of value
+            void write(int index, int depth = 0) {
+                switch (lua_type(_luaState, index)) {
+                    case LUA_TNIL:
+                        _writer.writeByte(serialized::Nil);
+                        break;
+
+                    case LUA_TBOOLEAN:
+                        _writer.writeByte(lua_toboolean(_luaState, index) ? serialized::True : serialized::False);
+                        break;
+
+                    case LUA_TNUMBER:
+                        writeNumber(index);
+                        break;
+
+                    case LUA_TSTRING:
+                        writeString(index);
+                        break;
+
+                    case LUA_TTABLE:
+                        writeTable(index, depth);
+                        break;
+
+                    default:
+                        throw TypeMismatchError(_luaState, index);
+                }
+            }
+        };
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Reads serialized values to Lua stack. Strings are pushed directly from input.
+        class Deserializer
+        {
+            lua_State* _luaState;
+            const uint8_t* _data;
+            const uint8_t* _end;
+
+            std::vector<std::pair<const char*, size_t>> _strings;
+
+            /// Index of table with read tables in order of their start
+            int _tables;
+            int _tableCount;
+
+            void corrupted() {
+                throw std::runtime_error("serialized data are corrupted");
+            }
+
+            uint8_t readByte() {
+                if (_data == _end)
+                    corrupted();
+                return *_data++;
+            }
+
+            uint64_t readVarint() {
+                uint64_t value = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    uint8_t byte = readByte();
+                    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0)
+                        return value;
+                }
+                corrupted();
+                return 0;
+            }
+
+            /// @return Varint which can't be larger than remaining data, so it can be used for sizes
+            size_t readCount(size_t itemSize = 1) {
+                uint64_t count = readVarint();
+                if (count > static_cast<uint64_t>(_end - _data) / itemSize)
+                    corrupted();
+                return static_cast<size_t>(count);
+            }
+
+            void readTable(int depth) {
+                if (depth > serialized::MaxDepth || !lua_checkstack(_luaState, 3))
+                    throw std::overflow_error("table is nested too deeply");
+
+                // Every value has at least one byte
+                size_t arrayCount = readCount();
+                size_t hashCount = readCount(2);
+
+                lua_createtable(_luaState, static_cast<int>(arrayCount), static_cast<int>(hashCount));
+
+                // Table is registered before content, so references from content point to it
+                lua_pushvalue(_luaState, -1);
+                lua_rawseti(_luaState, _tables, ++_tableCount);
+
+                int table = lua_gettop(_luaState);
+                for (size_t i = 1; i <= arrayCount; ++i) {
+                    read(depth + 1);
+                    lua_rawseti(_luaState, table, static_cast<int>(i));
+                }
+
+                for (size_t i = 0; i < hashCount; ++i) {
+                    // Nil and NaN keys would raise error in lua_rawset
+                    read(depth + 1);
+                    if (lua_isnil(_luaState, -1) || (lua_type(_luaState, -1) == LUA_TNUMBER && lua_tonumber(_luaState, -1) != lua_tonumber(_luaState, -1)))
+                        corrupted();
+                    read(depth + 1);
+                    lua_rawset(_luaState, table);
+                }
+            }
+
+        public:
+
+            /// @param tables   Index of empty table, which will be used for references to tables
+            Deserializer(lua_State* luaState, const char* data, size_t size, int tables)
+            : _luaState(luaState)
+            , _data(reinterpret_cast<const uint8_t*>(data))
+            , _end(reinterpret_cast<const uint8_t*>(data) + size)
+            , _tables(tables)
+            , _tableCount(0)
+            {
+            }
+
+            /// Pushes value of whole serialized data
+            void readAll() {
+                if (static_cast<size_t>(_end - _data) < sizeof(serialized::Magic) || memcmp(_data, serialized::Magic, sizeof(serialized::Magic)) != 0)
+                    corrupted();
+                _data += sizeof(serialized::Magic);
+
+                read();
+                if (_data != _end)
+                    corrupted();
+            }
+
+            /// Pushes read value
+            void read(int depth = 0) {
+                switch (readByte()) {
+                    case serialized::Nil:
+                        lua_pushnil(_luaState);
+                        break;
+
+                    case serialized::False:
+                        lua_pushboolean(_luaState, 0);
+                        break;
+
+                    case serialized::True:
+                        lua_pushboolean(_luaState, 1);
+                        break;
+
+                    case serialized::Integer: {
+                        uint64_t zigzag = readVarint();
+                        int64_t integer = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+#if LUA_VERSION_NUM > 502
+                        lua_pushinteger(_luaState, static_cast<lua_Integer>(integer));
+#else
+                        lua_pushnumber(_luaState, static_cast<lua_Number>(integer));
+#endif
+                        break;
+                    }
+
+                    case serialized::Number: {
+                        if (_end - _data < 8)
+                            corrupted();
+
+                        uint64_t bits = 0;
+                        for (int i = 0; i < 8; ++i)
+                            bits |= static_cast<uint64_t>(_data[i]) << (i * 8);
+                        _data += 8;
+
+                        double number;
+                        memcpy(&number, &bits, sizeof(number));
+                        lua_pushnumber(_luaState, static_cast<lua_Number>(number));
+                        break;
+                    }
+
+                    case serialized::String: {
+                        size_t length = readCount();
+                        const char* string = reinterpret_cast<const char*>(_data);
+                        _data += length;
+
+                        _strings.push_back(std::make_pair(string, length));
+                        lua_pushlstring(_luaState, string, length);
+                        break;
+                    }
+
+                    case serialized::StringRef: {
+                        uint64_t index = readVarint();
+                        if (index >= _strings.size())
+                            corrupted();
+                        lua_pushlstring(_luaState, _strings[index].first, _strings[index].second);
+                        break;
+                    }
+
+                    case serialized::Table:
+                        readTable(depth);
+                        break;
+
+                    case serialized::TableRef: {
+                        uint64_t index = readVarint();
+                        if (index >= static_cast<uint64_t>(_tableCount))
+                            corrupted();
+                        lua_rawgeti(_luaState, _tables, static_cast<int>(index) + 1);
+                        break;
+                    }
+
+                    default:
+                        corrupted();
+                }
+            }
+        };
+    }
+}
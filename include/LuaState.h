@@ -24,6 +24,7 @@
 #endif
 
 #include <cassert>
+#include <stdexcept>
 #include <string>
 #include <functional>
 #include <memory>
@@ -37,12 +38,22 @@
 
 #include "./LuaPrimitives.h"
 #include "./LuaStack.h"
+#include "./LuaWatchdog.h"
 #include "./LuaException.h"
 #include "./LuaStackItem.h"
+#include "./LuaTableIterator.h"
+#include "./LuaSerializer.h"
+#include "./LuaJson.h"
 #include "./LuaValue.h"
 #include "./LuaReturn.h"
 #include "./LuaFunctor.h"
 #include "./LuaRef.h"
+#include "./LuaCoroutine.h"
+#include "./LuaEnvironment.h"
+#include "./LuaArchive.h"
+#include "./LuaLibraries.h"
+#include "./LuaAllocator.h"
+#include "./LuaOptions.h"
 
 namespace lua {
     
@@ -50,12 +61,33 @@ namespace lua {
     /// Class that hold lua interpreter state. Lua state is managed by pointer which also is copied to lua::Ref values.
     class State
     {
+        friend Value transfer(const Value& source, State& destination);
+        friend class StringBuilder;
+        
         /// Class takes care of automaticaly closing Lua state when in destructor
         lua_State* _luaState;
         
         /// Class deletes DeallocQueue in destructor
         detail::DeallocQueue* _deallocQueue;
         
+        /// Archives searched by require function, archive searcher has pointer to this list
+        std::vector<const ScriptArchive*> _archives;
+        
+        /// Allocator owned by state, it is deleted after Lua state is closed
+        std::unique_ptr<PoolAllocator> _poolAllocator;
+        
+        /// Arena owned by state, it is deleted after Lua state is closed or discarded
+        std::unique_ptr<ArenaAllocator> _arenaAllocator;
+        
+        /// Lua state will not be closed in destructor when there are no functors
+        bool _fastTeardown;
+        
+        /// Allocator wrapper counting memory statistics
+        std::unique_ptr<detail::MemoryTracker> _memoryTracker;
+        
+        /// Budgets of calls, hook is installed only when some limit is set
+        std::unique_ptr<detail::Watchdog> _watchdog;
+        
         /// Function for metatable "__call" field. It calls stored functor pushes return values to stack.
         ///
         /// @pre In Lua C API during function calls lua_State moves stack index to place, where first element is our userdata, and next elements are returned values
@@ -80,21 +112,76 @@ namespace lua {
 //            }
 //            
 //            if (!executed)
-            if (lua_pcall(_luaState, 0, LUA_MULTRET, 0))
-                throw RuntimeError(_luaState);
+            detail::WatchdogScope watchdogScope(_luaState);
+            int status = lua_pcall(_luaState, 0, LUA_MULTRET, 0);
+            if (status != 0)
+                detail::throw_call_error(_luaState, status);
             
             int pushedValues = stack::top(_luaState) - index;
             return lua::Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, index, pushedValues, pushedValues > 0 ? pushedValues - 1 : 0));
         }
         
-        void initialize(bool loadLibs) {
+        void initialize(const StateOptions& options) {
             _deallocQueue = new detail::DeallocQueue();
-            _luaState = luaL_newstate();
-            assert(_luaState != nullptr);
+            _luaState = nullptr;
+            _fastTeardown = false;
+            
+            lua_Alloc allocator = options.allocator;
+            void* allocatorData = options.allocatorData;
             
-            if (loadLibs)
-                luaL_openlibs(_luaState);
+            if (options.poolAllocator) {
+                _poolAllocator.reset(new PoolAllocator(PoolAllocator::DefaultSlabSize, options.poolPlacement));
+                allocator = &PoolAllocator::allocate;
+                allocatorData = _poolAllocator.get();
+            }
+            else if (options.arenaAllocator) {
+                _arenaAllocator.reset(new ArenaAllocator());
+                allocator = &ArenaAllocator::allocate;
+                allocatorData = _arenaAllocator.get();
+            }
+            
+            if (options.trackMemory || options.memoryLimit != 0) {
+                _memoryTracker.reset(new detail::MemoryTracker(allocator, allocatorData, options.memoryLimit));
+                allocator = &detail::MemoryTracker::allocate;
+                allocatorData = _memoryTracker.get();
+            }
             
+            if (allocator != nullptr) {
+                _luaState = lua_newstate(allocator, allocatorData);
+                if (_luaState != nullptr)
+                    lua_atpanic(_luaState, &detail::panic);
+            }
+            
+#ifdef LUAJIT_VERSION
+            // LuaJIT on 64 bit platforms can't use custom allocators
+            if (_luaState == nullptr)
+                _luaState = luaL_newstate();
+#else
+            if (allocator == nullptr)
+                _luaState = luaL_newstate();
+#endif
+            // Allocator can refuse even base state, for example when memory limit is too small
+            if (_luaState == nullptr) {
+                delete _deallocQueue;
+                throw std::runtime_error("Lua state can't be created, allocator refused memory");
+            }
+            
+            // Tracker must be really used by Lua state, otherwise statistics are counted by Lua and limit can't be kept
+            if (_memoryTracker && lua_getallocf(_luaState, nullptr) != &detail::MemoryTracker::allocate) {
+                _memoryTracker.reset();
+                if (options.memoryLimit != 0) {
+                    lua_close(_luaState);
+                    delete _deallocQueue;
+                    throw std::runtime_error("Memory limit needs memory tracking with custom allocator");
+                }
+            }
+            
+            // Arena must be really used by Lua state, LuaJIT can ignore it
+            bool arena = _arenaAllocator || options.allocator == &ArenaAllocator::allocate;
+            _fastTeardown = options.fastTeardown && arena && lua_getallocf(_luaState, nullptr) == allocator;
+            
+            // Modules from archives are found before package.path is searched, searcher is installed with package library
+            detail::open_libraries(_luaState, options.libraries, options.lazyLibraries, &_archives);
             
             // We will create metatable for Lua functors for memory management and actual function call
             luaL_newmetatable(_luaState, "luaL_Functor");
@@ -116,13 +203,33 @@ namespace lua {
         /// Constructor creates new state and stores it to pointer.
         ///
         /// @param loadLibs     If we want to open standard libraries - function luaL_openlibs
-        State(bool loadLibs) { initialize(loadLibs); }
+        State(bool loadLibs) { initialize(StateOptions(loadLibs ? lib::All : lib::None)); }
         
         /// Constructor creates new state stores it to pointer and loads standard libraries
-        State() { initialize(true); }
+        State() { initialize(StateOptions()); }
+        
+        /// Constructor creates new state with given options
+        ///
+        /// @param options      Libraries and allocator of new state
+        State(const StateOptions& options) { initialize(options); }
+        
+        /// Constructor creates new state with custom allocator
+        ///
+        /// @param allocator        Allocation function, see lua_newstate
+        /// @param allocatorData    User data passed to allocation function
+        /// @param loadLibs         If we want to open standard libraries - function luaL_openlibs
+        State(lua_Alloc allocator, void* allocatorData, bool loadLibs = true) {
+            StateOptions options(loadLibs ? lib::All : lib::None);
+            options.allocator = allocator;
+            options.allocatorData = allocatorData;
+            initialize(options);
+        }
         
         ~State() {
-            lua_close(_luaState);
+            // Arena releases all memory at once, so we will close state only when functors or other userdata must be finalized
+            if (!_fastTeardown || detail::has_finalizers(_luaState))
+                lua_close(_luaState);
+            
             delete _deallocQueue;
         }
         
@@ -179,6 +286,159 @@ namespace lua {
 
             return executeLoadedFunction(stackTop);
         }
+        
+        /// Creates environment with own globals table. Scripts running in environment read missing globals from
+        /// this state, so thousands of environments can share one state with its bindings and libraries.
+        ///
+        /// @return New empty environment
+        Environment createEnvironment() const {
+            return Environment(_luaState, _deallocQueue);
+        }
+        
+        /// Executes file text in environment
+        ///
+        /// @throws lua::LoadError      When file cannot be found or loaded
+        /// @throws lua::RuntimeError   When there is runtime error
+        ///
+        /// @param filePath     File path indicating which file will be executed
+        /// @param environment  Environment where globals of script are stored
+        lua::Value doFile(const std::string& filePath, const Environment& environment) const {
+            int stackTop = stack::top(_luaState);
+            
+            if (luaL_loadfile(_luaState, filePath.c_str()))
+                throw LoadError(_luaState);
+            
+            environment.pushTable();
+            detail::set_environment(_luaState, stackTop + 1);
+            return executeLoadedFunction(stackTop);
+        }
+        
+        /// Execute string in environment
+        ///
+        /// @throws lua::LoadError      When string cannot be loaded
+        /// @throws lua::RuntimeError   When there is runtime error
+        ///
+        /// @param string       Command which will be executed
+        /// @param environment  Environment where globals of script are stored
+        lua::Value doString(const std::string& string, const Environment& environment) const {
+            int stackTop = stack::top(_luaState);
+            
+            if (luaL_loadstring(_luaState, string.c_str()))
+                throw LoadError(_luaState);
+            
+            environment.pushTable();
+            detail::set_environment(_luaState, stackTop + 1);
+            return executeLoadedFunction(stackTop);
+        }
+        
+        /// Loads string without executing it, so it can be called many times without parsing
+        ///
+        /// @throws lua::LoadError      When string cannot be loaded
+        ///
+        /// @param string   Script which will be loaded
+        ///
+        /// @return Function with loaded script
+        lua::Value compile(const std::string& string) const {
+            int stackTop = stack::top(_luaState);
+            
+            if (luaL_loadstring(_luaState, string.c_str()))
+                throw LoadError(_luaState);
+            
+            return lua::Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, stackTop, 1, 0));
+        }
+        
+        /// Loads string which will run in environment
+        ///
+        /// @throws lua::LoadError      When string cannot be loaded
+        ///
+        /// @param string       Script which will be loaded
+        /// @param environment  Environment where globals of script are stored
+        ///
+        /// @return Function with loaded script
+        lua::Value compile(const std::string& string, const Environment& environment) const {
+            lua::Value function = compile(string);
+            
+            environment.pushTable();
+            detail::set_environment(_luaState, function.getStackIndex());
+            return function;
+        }
+        
+        /// Restores value serialized with Value::serialize
+        ///
+        /// @throws std::runtime_error      When data are corrupted
+        /// @throws std::overflow_error     When tables are nested more than 200 levels
+        ///
+        /// @param data     Serialized data
+        /// @param size     Size of serialized data
+        ///
+        /// @return Restored value
+        lua::Value deserialize(const char* data, size_t size) const {
+            int stackTop = stack::top(_luaState);
+            
+            lua_checkstack(_luaState, 2);
+            lua_newtable(_luaState);
+            
+            try {
+                detail::Deserializer deserializer(_luaState, data, size, stackTop + 1);
+                deserializer.readAll();
+            } catch (...) {
+                lua_settop(_luaState, stackTop);
+                throw;
+            }
+            
+            // Table with references is removed
+            lua_remove(_luaState, stackTop + 1);
+            return lua::Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, stackTop, 1, 0));
+        }
+        
+        /// Restores value serialized with Value::serialize
+        ///
+        /// @throws std::runtime_error      When data are corrupted
+        /// @throws std::overflow_error     When tables are nested more than 200 levels
+        lua::Value deserialize(const std::string& data) const {
+            return deserialize(data.data(), data.size());
+        }
+        
+        /// Parses JSON directly to Lua values. Tables are created with final size, which is found by scanning
+        /// document structure first. JSON null is pushed as light userdata NULL, so arrays don't have holes.
+        ///
+        /// @throws std::runtime_error      When JSON is invalid
+        /// @throws std::overflow_error     When JSON is nested more than 200 levels
+        ///
+        /// @param json     JSON text, it doesn't have to be terminated
+        /// @param size     Length of JSON text
+        ///
+        /// @return Parsed value
+        lua::Value pushJson(const char* json, size_t size) const {
+            int stackTop = stack::top(_luaState);
+            
+            try {
+                detail::json::Parser parser(_luaState, json, size);
+                parser.parse();
+            } catch (...) {
+                lua_settop(_luaState, stackTop);
+                throw;
+            }
+            return lua::Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, stackTop, 1, 0));
+        }
+        
+        /// Parses JSON directly to Lua values, see pushJson with size
+        lua::Value pushJson(const std::string& json) const {
+            return pushJson(json.data(), json.size());
+        }
+        
+        /// Adds archive with modules which can be loaded with require function. Archives are searched right after
+        /// package.preload table, so modules found in archive are loaded without any file system access.
+        ///
+        /// @note Archive must exist until state is destroyed
+        ///
+        /// @param archive  Archive with modules
+        void addArchive(const ScriptArchive& archive) {
+            _archives.push_back(&archive);
+            
+            // Package library could be opened after state was created
+            detail::install_archive_searcher(_luaState, &_archives);
+        }
 
 #ifdef LUASTATE_DEBUG_MODE
         
@@ -212,6 +472,78 @@ namespace lua {
         }
 #endif
         
+        /// Memory statistics of state. When state was not created with StateOptions::trackMemory or memory limit,
+        /// only live bytes are filled in.
+        ///
+        /// @return Copy of current statistics
+        MemoryStats memoryStats() const {
+            if (_memoryTracker)
+                return _memoryTracker->stats();
+            
+            MemoryStats stats;
+            stats.liveBytes = static_cast<size_t>(lua_gc(_luaState, LUA_GCCOUNT, 0)) * 1024 + lua_gc(_luaState, LUA_GCCOUNTB, 0);
+            return stats;
+        }
+        
+        /// Changes hard limit of memory allocated by state
+        ///
+        /// @note State must be created with StateOptions::trackMemory or memory limit
+        ///
+        /// @throws std::runtime_error  When state doesn't count memory or it can't use custom allocator
+        ///
+        /// @param limit    Limit in bytes, zero means no limit
+        void setMemoryLimit(size_t limit) {
+            if (!_memoryTracker)
+                throw std::runtime_error("Memory limit needs memory tracking with custom allocator");
+            _memoryTracker->setLimit(limit);
+        }
+        
+        /// Limits every call from C++ to Lua (doString, doFile, lua::Value calls and coroutine resumes). Limits are
+        /// checked by count hook, so instruction budget is counted with given granularity. When budget is exceeded,
+        /// lua::TimeoutError is thrown.
+        ///
+        /// Timeout in unprotected lua::Value call from bound C++ function is Lua error, which jumps over C++ frames
+        /// of that function, so their values leak. Bound functions should use lua::Value::call and catch
+        /// lua::TimeoutError, outer call then times out too, because its budget stays exceeded.
+        ///
+        /// @param instructions Maximum number of instructions of one call, zero means no limit
+        /// @param seconds      Maximum duration of one call, zero means no limit
+        /// @param granularity  Number of instructions between checks, smaller values cost more
+        ///
+        /// @note Coroutines created before limits were set are not limited
+        void setExecutionLimits(unsigned long long instructions, double seconds = 0, int granularity = 1000) {
+            if (instructions == 0 && seconds <= 0) {
+                clearExecutionLimits();
+                return;
+            }
+            
+            if (!_watchdog) {
+                _watchdog.reset(new detail::Watchdog());
+                
+                lua_pushlightuserdata(_luaState, detail::watchdog_key());
+                lua_pushlightuserdata(_luaState, _watchdog.get());
+                lua_rawset(_luaState, LUA_REGISTRYINDEX);
+            }
+            
+            _watchdog->instructionLimit = instructions;
+            _watchdog->secondsLimit = seconds;
+            _watchdog->granularity = granularity > 0 ? granularity : 1;
+            lua_sethook(_luaState, &detail::watchdogHook, LUA_MASKCOUNT, _watchdog->granularity);
+        }
+        
+        /// Removes limits set with setExecutionLimits
+        void clearExecutionLimits() {
+            if (!_watchdog)
+                return;
+            
+            lua_sethook(_luaState, nullptr, 0, 0);
+            
+            lua_pushlightuserdata(_luaState, detail::watchdog_key());
+            lua_pushnil(_luaState);
+            lua_rawset(_luaState, LUA_REGISTRYINDEX);
+            _watchdog.reset();
+        }
+        
         /// Get pointer of Lua state
         ///
         /// @return Pointer of Lua state
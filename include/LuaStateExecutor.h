@@ -0,0 +1,208 @@
+//
+//  LuaStateExecutor.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+#include "./LuaQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace lua {
+
+    namespace detail {
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Calls Lua function and stores its result to promise
+        template <typename R>
+        struct PromiseCall
+        {
+            template <typename ... Ts, size_t... Indexes>
+            static void call(State& state, const std::string& name, std::promise<R>& promise, const std::tuple<Ts...>& args, traits::index_tuple<Indexes...>) {
+                R result = state[name.c_str()].call(std::get<Indexes>(args)...);
+                promise.set_value(result);
+            }
+        };
+
+        template <>
+        struct PromiseCall<void>
+        {
+            template <typename ... Ts, size_t... Indexes>
+            static void call(State& state, const std::string& name, std::promise<void>& promise, const std::tuple<Ts...>& args, traits::index_tuple<Indexes...>) {
+                state[name.c_str()].call(std::get<Indexes>(args)...);
+                promise.set_value();
+            }
+        };
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Owns lua::State on dedicated thread and executes tasks posted from any thread. Tasks are passed through lock
+    /// free queue and executed in batches, thread is woken up only when it was waiting for tasks.
+    class StateExecutor
+    {
+    public:
+
+        /// Task executed on executor thread
+        typedef std::function<void(State&)> Task;
+
+        /// Routine which initializes state on executor thread
+        typedef std::function<void(State&)> Initializer;
+
+    private:
+
+        detail::MpscQueue<Task> _queue;
+
+        /// Maximum number of tasks executed before checking for stop request
+        size_t _batchSize;
+
+        std::atomic<bool> _stopping;
+
+        /// Set when executor thread is going to wait for tasks
+        std::atomic<bool> _sleeping;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+
+        std::atomic<uint64_t> _executed;
+        std::atomic<uint64_t> _batches;
+
+        std::thread _thread;
+
+        void wake() {
+            if (_sleeping.load()) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _condition.notify_one();
+            }
+        }
+
+        /// @return Number of executed tasks
+        size_t drain(State& state) {
+            size_t count = 0;
+            Task task;
+            while (count < _batchSize && _queue.pop(task)) {
+                task(state);
+                task = nullptr;
+                ++count;
+            }
+            return count;
+        }
+
+        void run(const StateOptions& options, const Initializer& initializer, std::promise<void>& ready) {
+            std::unique_ptr<State> state;
+            try {
+                state.reset(new State(options));
+                if (initializer)
+                    initializer(*state);
+            } catch (...) {
+                ready.set_exception(std::current_exception());
+                return;
+            }
+            ready.set_value();
+
+            for (;;) {
+                size_t count = drain(*state);
+                if (count > 0) {
+                    _executed.fetch_add(count, std::memory_order_relaxed);
+                    _batches.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                if (_stopping.load() && _queue.empty())
+                    break;
+
+                // Producers check sleeping flag after push, so queue must be checked again after flag is set
+                std::unique_lock<std::mutex> lock(_mutex);
+                _sleeping.store(true);
+                _condition.wait(lock, [this]() { return !_queue.empty() || _stopping.load(); });
+                _sleeping.store(false);
+            }
+        }
+
+    public:
+
+        /// Creates state on new thread and runs initialization routine there. Constructor waits until state is
+        /// initialized.
+        ///
+        /// @param initializer  Routine called on executor thread after state is created
+        /// @param options      Options of created state
+        /// @param batchSize    Maximum number of tasks executed in one batch
+        ///
+        /// @throws Exception thrown from initialization routine
+        StateExecutor(Initializer initializer = Initializer(), const StateOptions& options = StateOptions(), size_t batchSize = 64)
+        : _batchSize(batchSize > 0 ? batchSize : 1)
+        , _stopping(false)
+        , _sleeping(false)
+        , _executed(0)
+        , _batches(0)
+        {
+            std::promise<void> ready;
+            std::future<void> initialized = ready.get_future();
+            _thread = std::thread(&StateExecutor::run, this, options, initializer, std::ref(ready));
+
+            try {
+                initialized.get();
+            } catch (...) {
+                _thread.join();
+                throw;
+            }
+        }
+
+        /// Executes all posted tasks and stops thread
+        ~StateExecutor() {
+            if (_thread.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _stopping.store(true);
+                }
+                _condition.notify_one();
+                _thread.join();
+            }
+        }
+
+        // Executor is non-copyable
+        StateExecutor(const StateExecutor& other) = delete;
+        StateExecutor& operator=(const StateExecutor&) = delete;
+
+        /// Posts task which will be executed on executor thread. Can be called from any thread.
+        ///
+        /// @note Task must not throw and must not keep lua::Value instances after it returns
+        void post(Task task) {
+            _queue.push(std::move(task));
+            wake();
+        }
+
+        /// Calls global Lua function on executor thread. Arguments are copied.
+        ///
+        /// @param name     Name of global function
+        /// @param args     Arguments of function
+        ///
+        /// @return Future with function result or with exception thrown from call
+        template <typename R, typename ... Ts>
+        std::future<R> call(const std::string& name, Ts... args) {
+            std::shared_ptr<std::promise<R>> promise = std::make_shared<std::promise<R>>();
+            std::future<R> result = promise->get_future();
+
+            std::tuple<Ts...> arguments(args...);
+            post([promise, name, arguments](State& state) {
+                try {
+                    detail::PromiseCall<R>::call(state, name, *promise, arguments, typename traits::make_indexes<Ts...>::type());
+                } catch (...) {
+                    promise->set_exception(std::current_exception());
+                }
+            });
+            return result;
+        }
+
+        /// @return Number of executed tasks
+        uint64_t executedTasks() const { return _executed.load(std::memory_order_relaxed); }
+
+        /// @return Number of batches, average batch size is executedTasks() / batches()
+        uint64_t batches() const { return _batches.load(std::memory_order_relaxed); }
+    };
+}
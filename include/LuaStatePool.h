@@ -0,0 +1,430 @@
+//
+//  LuaStatePool.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace lua {
+
+    namespace detail {
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Lock free stack of indexes with fixed capacity. Head contains tag, which is incremented with every change,
+        /// so stack doesn't suffer from ABA problem.
+        class IndexStack
+        {
+            /// Lower 32 bits are index + 1 of top item (zero when empty), upper 32 bits are tag
+            std::atomic<uint64_t> _head;
+
+            /// Index + 1 of next item for every index
+            std::unique_ptr<std::atomic<uint32_t>[]> _next;
+
+        public:
+
+            IndexStack(size_t capacity)
+            : _head(0)
+            , _next(new std::atomic<uint32_t>[capacity])
+            {
+                for (size_t i = 0; i < capacity; ++i)
+                    _next[i].store(0, std::memory_order_relaxed);
+            }
+
+            void push(uint32_t index) {
+                uint64_t head = _head.load(std::memory_order_relaxed);
+                uint64_t newHead;
+                do {
+                    _next[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+                    newHead = ((head >> 32) + 1) << 32 | (index + 1);
+                } while (!_head.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            /// @return false when stack is empty
+            bool pop(uint32_t& index) {
+                uint64_t head = _head.load(std::memory_order_acquire);
+                uint64_t newHead;
+                do {
+                    uint32_t top = static_cast<uint32_t>(head);
+                    if (top == 0)
+                        return false;
+
+                    index = top - 1;
+                    newHead = ((head >> 32) + 1) << 32 | _next[index].load(std::memory_order_relaxed);
+                } while (!_head.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire));
+                return true;
+            }
+        };
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pool of initialized Lua states for multi-threaded servers. States are created by user's init routine and
+    /// handed out with RAII leases. Checkout and checkin are lock free, state is used only by one thread at a time.
+    class StatePool
+    {
+    public:
+
+        /// Routine which initializes new state, for example loads bootstrap scripts
+        typedef std::function<void(State&)> Initializer;
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Options of pool
+        struct Options
+        {
+            /// Number of states created in constructor, pool never shrinks under this size
+            size_t minSize;
+
+            /// Maximum number of states, when all are leased acquire waits
+            size_t maxSize;
+
+            /// When more states are idle, returned states are destroyed
+            size_t maxIdle;
+
+            /// Global values of returned state are reset to values after initialization. Only _G table is restored,
+            /// tables referenced from it are not.
+            bool resetGlobals;
+
+            /// Options of created states
+            StateOptions stateOptions;
+
+            Options(size_t size = 1)
+            : minSize(size)
+            , maxSize(size)
+            , maxIdle(size)
+            , resetGlobals(false)
+            {
+            }
+        };
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Counters of pool usage
+        struct Counters
+        {
+            /// Number of states checked out by acquire and tryAcquire
+            uint64_t acquisitions;
+
+            /// Number of acquisitions, which had to wait for returned state
+            uint64_t exhaustions;
+
+            /// Total time of waiting for returned states
+            uint64_t waitNanoseconds;
+
+            /// Number of created and destroyed states
+            uint64_t created;
+            uint64_t destroyed;
+        };
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Lease of state from pool. State is returned to pool when lease is destroyed.
+        class Lease
+        {
+            friend class StatePool;
+
+            StatePool* _pool;
+            uint32_t _slot;
+
+            Lease(StatePool* pool, uint32_t slot) : _pool(pool), _slot(slot) {}
+
+        public:
+
+            Lease() : _pool(nullptr), _slot(0) {}
+
+            Lease(Lease&& other) : _pool(other._pool), _slot(other._slot) {
+                other._pool = nullptr;
+            }
+
+            Lease& operator=(Lease&& other) {
+                if (this != &other) {
+                    release();
+                    _pool = other._pool;
+                    _slot = other._slot;
+                    other._pool = nullptr;
+                }
+                return *this;
+            }
+
+            // Lease is non-copyable
+            Lease(const Lease& other) = delete;
+            Lease& operator=(const Lease&) = delete;
+
+            ~Lease() { release(); }
+
+            /// Returns state to pool before lease is destroyed
+            ///
+            /// @note All lua::Value instances of state must be destroyed
+            void release() {
+                if (_pool != nullptr) {
+                    _pool->checkin(_slot);
+                    _pool = nullptr;
+                }
+            }
+
+            bool isValid() const { return _pool != nullptr; }
+
+            State& operator*() const { return *_pool->_states[_slot]; }
+            State* operator->() const { return _pool->_states[_slot].get(); }
+        };
+
+    private:
+
+        Initializer _initializer;
+        Options _options;
+
+        /// Slots for states, slot without state is vacant
+        std::unique_ptr<std::unique_ptr<State>[]> _states;
+
+        /// Slots with idle states
+        detail::IndexStack _idle;
+
+        /// Slots without states
+        detail::IndexStack _vacant;
+
+        std::atomic<size_t> _idleCount;
+        std::atomic<size_t> _stateCount;
+
+        std::atomic<uint64_t> _acquisitions;
+        std::atomic<uint64_t> _exhaustions;
+        std::atomic<uint64_t> _waitNanoseconds;
+        std::atomic<uint64_t> _created;
+        std::atomic<uint64_t> _destroyed;
+
+        /// Key of baseline globals in registry
+        static const char* baselineKey() {
+            static const char key = 0;
+            return &key;
+        }
+
+        void createState(uint32_t slot) {
+            std::unique_ptr<State> state(new State(_options.stateOptions));
+            _initializer(*state);
+
+            if (_options.resetGlobals)
+                saveBaseline(state->getState());
+
+            _states[slot] = std::move(state);
+            _stateCount.fetch_add(1, std::memory_order_relaxed);
+            _created.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void destroyState(uint32_t slot) {
+            _states[slot].reset();
+            _stateCount.fetch_sub(1, std::memory_order_relaxed);
+            _destroyed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static void pushGlobals(lua_State* luaState) {
+#if LUA_VERSION_NUM > 501
+            lua_rawgeti(luaState, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+            lua_pushvalue(luaState, LUA_GLOBALSINDEX);
+#endif
+        }
+
+        /// Stores shallow copy of _G table to registry
+        static void saveBaseline(lua_State* luaState) {
+            lua_pushlightuserdata(luaState, const_cast<char*>(baselineKey()));
+            lua_newtable(luaState);
+            pushGlobals(luaState);
+
+            lua_pushnil(luaState);
+            while (lua_next(luaState, -2)) {
+                lua_pushvalue(luaState, -2);
+                lua_insert(luaState, -2);
+                lua_rawset(luaState, -5);
+            }
+            lua_pop(luaState, 1);
+            lua_rawset(luaState, LUA_REGISTRYINDEX);
+        }
+
+        /// Removes globals which are not in baseline and restores changed ones
+        static void restoreBaseline(lua_State* luaState) {
+            lua_settop(luaState, 0);
+
+            lua_pushlightuserdata(luaState, const_cast<char*>(baselineKey()));
+            lua_rawget(luaState, LUA_REGISTRYINDEX);
+            pushGlobals(luaState);
+
+            // Keys can't be removed while traversing, so they are collected first
+            lua_newtable(luaState);
+            int removed = 0;
+
+            lua_pushnil(luaState);
+            while (lua_next(luaState, 2)) {
+                lua_pop(luaState, 1);
+                lua_pushvalue(luaState, -1);
+                lua_rawget(luaState, 1);
+                bool inBaseline = !lua_isnil(luaState, -1);
+                lua_pop(luaState, 1);
+
+                if (!inBaseline) {
+                    lua_pushvalue(luaState, -1);
+                    lua_rawseti(luaState, 3, ++removed);
+                }
+            }
+
+            for (int i = 1; i <= removed; ++i) {
+                lua_rawgeti(luaState, 3, i);
+                lua_pushnil(luaState);
+                lua_rawset(luaState, 2);
+            }
+
+            lua_pushnil(luaState);
+            while (lua_next(luaState, 1)) {
+                lua_pushvalue(luaState, -2);
+                lua_insert(luaState, -2);
+                lua_rawset(luaState, 2);
+            }
+
+            lua_settop(luaState, 0);
+        }
+
+        /// Takes idle state or creates new one
+        ///
+        /// @return false when all states are leased and pool can't grow
+        bool checkout(uint32_t& slot) {
+            if (_idle.pop(slot)) {
+                _idleCount.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            if (_vacant.pop(slot)) {
+                try {
+                    createState(slot);
+                } catch (...) {
+                    _vacant.push(slot);
+                    throw;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void checkin(uint32_t slot) {
+
+            // Pool shrinks when there are too many idle states
+            if (_idleCount.load(std::memory_order_relaxed) >= _options.maxIdle && _stateCount.load(std::memory_order_relaxed) > _options.minSize) {
+                destroyState(slot);
+                _vacant.push(slot);
+                return;
+            }
+
+            if (_options.resetGlobals)
+                restoreBaseline(_states[slot]->getState());
+
+            _idleCount.fetch_add(1, std::memory_order_relaxed);
+            _idle.push(slot);
+        }
+
+    public:
+
+        /// Creates pool and its initial states
+        ///
+        /// @param initializer  Routine which initializes every created state
+        /// @param options      Sizes of pool and options of states
+        StatePool(Initializer initializer, const Options& options = Options())
+        : _initializer(initializer)
+        , _options(options)
+        , _states(new std::unique_ptr<State>[options.maxSize])
+        , _idle(options.maxSize)
+        , _vacant(options.maxSize)
+        , _idleCount(0)
+        , _stateCount(0)
+        , _acquisitions(0)
+        , _exhaustions(0)
+        , _waitNanoseconds(0)
+        , _created(0)
+        , _destroyed(0)
+        {
+            assert(_options.minSize <= _options.maxSize && _options.maxSize > 0);
+
+            for (size_t slot = _options.maxSize; slot > _options.minSize; --slot)
+                _vacant.push(static_cast<uint32_t>(slot - 1));
+
+            for (size_t slot = _options.minSize; slot > 0; --slot) {
+                createState(static_cast<uint32_t>(slot - 1));
+                _idleCount.fetch_add(1, std::memory_order_relaxed);
+                _idle.push(static_cast<uint32_t>(slot - 1));
+            }
+        }
+
+        /// Creates pool with fixed number of states
+        StatePool(Initializer initializer, size_t size)
+        : StatePool(initializer, Options(size))
+        {
+        }
+
+        /// @note All leases must be released before pool is destroyed
+        ~StatePool() {
+            assert(_idleCount.load() == _stateCount.load());
+        }
+
+        // Pool is non-copyable
+        StatePool(const StatePool& other) = delete;
+        StatePool& operator=(const StatePool&) = delete;
+
+        /// Leases state from pool. When all states are leased and pool can't grow, waits until some state is returned.
+        ///
+        /// @return Lease with state
+        Lease acquire() {
+            uint32_t slot;
+            if (checkout(slot)) {
+                _acquisitions.fetch_add(1, std::memory_order_relaxed);
+                return Lease(this, slot);
+            }
+
+            _exhaustions.fetch_add(1, std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+
+            for (unsigned spin = 0; !checkout(slot); ++spin) {
+                if (spin < 64)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+
+            auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            _waitNanoseconds.fetch_add(waited.count(), std::memory_order_relaxed);
+            _acquisitions.fetch_add(1, std::memory_order_relaxed);
+            return Lease(this, slot);
+        }
+
+        /// Leases state from pool without waiting
+        ///
+        /// @param lease    Lease where state will be stored
+        ///
+        /// @return false when all states are leased and pool can't grow
+        bool tryAcquire(Lease& lease) {
+            uint32_t slot;
+            if (!checkout(slot))
+                return false;
+
+            _acquisitions.fetch_add(1, std::memory_order_relaxed);
+            lease = Lease(this, slot);
+            return true;
+        }
+
+        /// @return Snapshot of pool counters
+        Counters counters() const {
+            Counters counters;
+            counters.acquisitions = _acquisitions.load(std::memory_order_relaxed);
+            counters.exhaustions = _exhaustions.load(std::memory_order_relaxed);
+            counters.waitNanoseconds = _waitNanoseconds.load(std::memory_order_relaxed);
+            counters.created = _created.load(std::memory_order_relaxed);
+            counters.destroyed = _destroyed.load(std::memory_order_relaxed);
+            return counters;
+        }
+
+        /// @return Number of existing states
+        size_t size() const { return _stateCount.load(std::memory_order_relaxed); }
+
+        /// @return Number of states which are not leased
+        size_t idle() const { return _idleCount.load(std::memory_order_relaxed); }
+    };
+}
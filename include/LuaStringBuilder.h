@@ -0,0 +1,121 @@
+//
+//  LuaStringBuilder.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+namespace lua {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Builds string directly in Lua memory with luaL_Buffer, so large generated string is not copied from
+    /// std::string. Finished string is returned as lua::Value.
+    ///
+    /// @note luaL_Buffer uses Lua stack, so stack of state can't be used until builder is finished or destroyed
+    class StringBuilder
+    {
+        lua_State* _luaState;
+        detail::DeallocQueue* _deallocQueue;
+
+        /// Top of stack before builder was created
+        int _top;
+        bool _finished;
+
+        luaL_Buffer _buffer;
+
+    public:
+
+        StringBuilder(State& state)
+        : _luaState(state._luaState)
+        , _deallocQueue(state._deallocQueue)
+        , _top(stack::top(state._luaState))
+        , _finished(false)
+        {
+            luaL_buffinit(_luaState, &_buffer);
+        }
+
+        /// Unfinished string is discarded
+        ~StringBuilder() {
+            if (!_finished)
+                lua_settop(_luaState, _top);
+        }
+
+        // String builder is non-copyable
+        StringBuilder(const StringBuilder& other) = delete;
+        StringBuilder& operator=(const StringBuilder&) = delete;
+
+        StringBuilder& append(const char* data, size_t size) {
+            luaL_addlstring(&_buffer, data, size);
+            return *this;
+        }
+
+        StringBuilder& append(const char* string) {
+            return append(string, strlen(string));
+        }
+
+        StringBuilder& append(const std::string& string) {
+            return append(string.data(), string.size());
+        }
+
+        StringBuilder& append(char character) {
+            luaL_addchar(&_buffer, character);
+            return *this;
+        }
+
+        /// Appends integer, it is written directly to buffer of luaL_Buffer
+        StringBuilder& appendInteger(long long value) {
+            char* space = luaL_prepbuffer(&_buffer);
+            luaL_addsize(&_buffer, snprintf(space, LUAL_BUFFERSIZE, "%lld", value));
+            return *this;
+        }
+
+        /// Appends number in same format as tostring function
+        StringBuilder& appendNumber(lua_Number value) {
+            char* space = luaL_prepbuffer(&_buffer);
+            luaL_addsize(&_buffer, snprintf(space, LUAL_BUFFERSIZE, LUA_NUMBER_FMT, value));
+            return *this;
+        }
+
+        /// Appends text formatted with printf format
+        StringBuilder& appendFormat(const char* format, ...) {
+            va_list arguments;
+            va_start(arguments, format);
+            char* space = luaL_prepbuffer(&_buffer);
+            int length = vsnprintf(space, LUAL_BUFFERSIZE, format, arguments);
+            va_end(arguments);
+
+            if (length < 0)
+                return *this;
+
+            if (length < LUAL_BUFFERSIZE) {
+                luaL_addsize(&_buffer, length);
+                return *this;
+            }
+
+            // Long text doesn't fit to buffer, so it is formatted again to temporary memory
+            std::vector<char> text(length + 1);
+            va_start(arguments, format);
+            vsnprintf(text.data(), text.size(), format, arguments);
+            va_end(arguments);
+            return append(text.data(), length);
+        }
+
+        /// Finishes string, builder can't be used after this
+        ///
+        /// @return Built string
+        Value finish() {
+            assert(!_finished);
+            _finished = true;
+
+            luaL_pushresult(&_buffer);
+            return Value(std::make_shared<detail::StackItem>(_luaState, _deallocQueue, _top, 1, 0));
+        }
+    };
+}
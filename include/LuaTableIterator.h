@@ -0,0 +1,188 @@
+//
+//  LuaTableIterator.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+namespace lua {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// View of value on Lua stack. It is not reference counted like lua::Value, so it is valid only in iteration
+    /// step where it was created.
+    class StackSlot
+    {
+        lua_State* _luaState;
+        int _index;
+
+    public:
+
+        StackSlot(lua_State* luaState, int index)
+        : _luaState(luaState)
+        , _index(index)
+        {
+        }
+
+        /// @return Position on stack
+        int index() const { return _index; }
+
+        /// @return Lua type like LUA_TNUMBER
+        int type() const { return lua_type(_luaState, _index); }
+
+        /// @return Name of Lua type
+        const char* typeName() const { return lua_typename(_luaState, type()); }
+
+        /// Check if value is some type from LuaPrimitives.h file
+        template<typename T>
+        bool is() const {
+            return stack::check<T>(_luaState, _index);
+        }
+
+        /// Reads value with stack::read, strings are read without converting numbers on stack
+        template<typename T>
+        T to() const {
+            return stack::read<T>(_luaState, _index);
+        }
+
+        template<typename T>
+        operator T() const {
+            return to<T>();
+        }
+
+        /// @return String or nullptr when value is not string, numbers are not converted because lua_next
+        /// would get changed key
+        const char* toCStr() const {
+            return lua_type(_luaState, _index) == LUA_TSTRING ? lua_tostring(_luaState, _index) : nullptr;
+        }
+
+        /// @return String with embedded zeros, numbers are converted on copy of value
+        std::string toString() const {
+            size_t length;
+            if (lua_type(_luaState, _index) == LUA_TSTRING) {
+                const char* string = lua_tolstring(_luaState, _index, &length);
+                return std::string(string, length);
+            }
+
+            lua_pushvalue(_luaState, _index);
+            const char* string = lua_tolstring(_luaState, -1, &length);
+            std::string result = string != nullptr ? std::string(string, length) : std::string();
+            lua_pop(_luaState, 1);
+            return result;
+        }
+
+        lua::Number toNumber() const {
+            return lua_tonumber(_luaState, _index);
+        }
+
+        int toInt() const {
+            return static_cast<int>(lua_tointeger(_luaState, _index));
+        }
+
+        bool toBool() const {
+            return lua_toboolean(_luaState, _index) != 0;
+        }
+    };
+
+    template<>
+    inline const char* StackSlot::to<const char*>() const {
+        return toCStr();
+    }
+
+    template<>
+    inline std::string StackSlot::to<std::string>() const {
+        return toString();
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Key and value of table entry
+    struct TableEntry
+    {
+        StackSlot key;
+        StackSlot value;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Input iterator over table with lua_next. Key and value are kept on stack during iteration step, so values
+    /// pushed in step must be popped before next step. Stack is restored when iteration ends, also by break or
+    /// exception.
+    class TableIterator
+    {
+        lua_State* _luaState;
+
+        /// Position of table on stack
+        int _table;
+
+        /// Top of stack before iteration
+        int _top;
+
+        bool _finished;
+
+        void next() {
+            if (lua_next(_luaState, _table) == 0)
+                _finished = true;
+        }
+
+    public:
+
+        /// Iterator at end of table
+        TableIterator()
+        : _luaState(nullptr)
+        , _table(0)
+        , _top(0)
+        , _finished(true)
+        {
+        }
+
+        /// Iterator at first entry of table
+        ///
+        /// @param luaState     Pointer of Lua state
+        /// @param table        Absolute position of table on stack
+        TableIterator(lua_State* luaState, int table)
+        : _luaState(luaState)
+        , _table(table)
+        , _top(stack::top(luaState))
+        , _finished(false)
+        {
+            lua_checkstack(_luaState, 3);
+            lua_pushnil(_luaState);
+            next();
+        }
+
+        TableIterator(TableIterator&& other)
+        : _luaState(other._luaState)
+        , _table(other._table)
+        , _top(other._top)
+        , _finished(other._finished)
+        {
+            other._finished = true;
+        }
+
+        /// Pops key and value of unfinished iteration
+        ~TableIterator() {
+            if (!_finished)
+                lua_settop(_luaState, _top);
+        }
+
+        // Table iterator is non-copyable
+        TableIterator(const TableIterator& other) = delete;
+        TableIterator& operator=(const TableIterator&) = delete;
+
+        TableEntry operator*() const {
+            return TableEntry{ StackSlot(_luaState, _top + 1), StackSlot(_luaState, _top + 2) };
+        }
+
+        TableIterator& operator++() {
+            LUASTATE_ASSERT(stack::top(_luaState) == _top + 2);
+
+            // Value is popped and key stays for lua_next
+            lua_settop(_luaState, _top + 1);
+            next();
+            return *this;
+        }
+
+        /// Only finished iterators are equal
+        bool operator==(const TableIterator& other) const { return _finished == other._finished; }
+        bool operator!=(const TableIterator& other) const { return _finished != other._finished; }
+    };
+}
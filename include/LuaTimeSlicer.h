@@ -0,0 +1,243 @@
+//
+//  LuaTimeSlicer.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <deque>
+#include <unordered_map>
+
+namespace lua {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs scripts of one state in coroutines and preempts them after instruction quantum, so long scripts can't
+    /// delay short ones. Preempted scripts are resumed in round-robin order.
+    ///
+    /// @note Script is preempted only when it can yield, so it is not preempted inside pcall on Lua 5.1 and 5.2 or
+    /// inside bound C++ functions. On Lua 5.1 it is also not preempted inside metamethods, iterators of generic for,
+    /// tail calls and calls of functions without name. LuaJIT doesn't call hooks from compiled code.
+    ///
+    /// @note Limits of State::setExecutionLimits apply to each slice, because every resume is call from C++. They
+    /// stop slice which can't be preempted.
+    class TimeSlicer
+    {
+    public:
+
+        /// Called when script finishes with its returned values
+        typedef std::function<void(uint64_t id, const Value& result)> FinishHandler;
+
+    private:
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        struct Task
+        {
+            uint64_t id;
+            Coroutine coroutine;
+            FinishHandler onFinish;
+
+            Task(uint64_t id, const Value& function, const FinishHandler& onFinish)
+            : id(id)
+            , coroutine(function)
+            , onFinish(onFinish)
+            {
+            }
+        };
+
+        State& _state;
+        int _quantum;
+
+        std::unordered_map<uint64_t, std::unique_ptr<Task>> _tasks;
+        std::deque<uint64_t> _queue;
+        uint64_t _nextId;
+
+        /// Thread which is running now, only this thread is preempted
+        lua_State* _current;
+
+        uint64_t _slices;
+        uint64_t _preemptions;
+
+        /// Key of time slicer pointer in LUA_REGISTRYINDEX
+        static void* registryKey() {
+            static const char key = 0;
+            return const_cast<char*>(&key);
+        }
+
+        /// @return true when running function can yield from hook
+        static bool isYieldable(lua_State* luaState) {
+#if LUA_VERSION_NUM >= 503
+            return lua_isyieldable(luaState) != 0;
+#else
+            lua_Debug debug;
+            lua_Debug caller;
+            for (int level = 0; lua_getstack(luaState, level, &debug); ++level) {
+                lua_getinfo(luaState, "Sn", &debug);
+
+                // C function on call stack would be yielded across
+                if (strcmp(debug.what, "C") == 0)
+                    return false;
+
+#if LUA_VERSION_NUM == 501
+                // Lua 5.1 runs metamethods and iterators of generic for in nested call of interpreter, which can't
+                // be resumed. Only calls by name are known to come from call instruction, so functions without name
+                // (metamethods, tail calls and anonymous calls) are not preempted. Function of coroutine has no
+                // caller and is resumed.
+                if (!lua_getstack(luaState, level + 1, &caller))
+                    return true;
+                if (*debug.namewhat == '\0' || strcmp(debug.name, "(for generator)") == 0)
+                    return false;
+#endif
+            }
+            return true;
+#endif
+        }
+
+        static void sliceHook(lua_State* luaState, lua_Debug*) {
+            int count = lua_gethookcount(luaState);
+
+            // Hook of thread replaces watchdog hook, so budget of setExecutionLimits is checked here
+            detail::Watchdog* watchdog = detail::find_watchdog(luaState);
+            if (watchdog != nullptr && watchdog->depth > 0 && detail::watchdog_exceeded(watchdog, count)) {
+                lua_sethook(luaState, &sliceHook, LUA_MASKCOUNT, 1);
+                luaL_error(luaState, "%s", watchdog->reason);
+                return;
+            }
+
+            lua_pushlightuserdata(luaState, registryKey());
+            lua_rawget(luaState, LUA_REGISTRYINDEX);
+            TimeSlicer* slicer = static_cast<TimeSlicer*>(lua_touserdata(luaState, -1));
+            lua_pop(luaState, 1);
+            if (slicer == nullptr)
+                return;
+
+            // Thread could stay with hook of timed out call
+            if (count != slicer->_quantum)
+                lua_sethook(luaState, &sliceHook, LUA_MASKCOUNT, slicer->_quantum);
+
+            // Coroutines created by script have same hook, but they are resumed by script. Script which can't
+            // yield now runs until next hook call.
+            if (luaState != slicer->_current || !isYieldable(luaState))
+                return;
+
+            ++slicer->_preemptions;
+            lua_yield(luaState, 0);
+        }
+
+        void remove(uint64_t id) {
+            _tasks.erase(id);
+        }
+
+    public:
+
+        /// @param state    State where scripts will run, only one time slicer can be used with state
+        /// @param quantum  Number of instructions after which script is preempted
+        TimeSlicer(State& state, int quantum = 10000)
+        : _state(state)
+        , _quantum(quantum > 0 ? quantum : 1)
+        , _nextId(1)
+        , _current(nullptr)
+        , _slices(0)
+        , _preemptions(0)
+        {
+            lua_State* luaState = _state.getState();
+            lua_pushlightuserdata(luaState, registryKey());
+            lua_pushlightuserdata(luaState, this);
+            lua_rawset(luaState, LUA_REGISTRYINDEX);
+        }
+
+        ~TimeSlicer() {
+            lua_State* luaState = _state.getState();
+            lua_pushlightuserdata(luaState, registryKey());
+            lua_pushnil(luaState);
+            lua_rawset(luaState, LUA_REGISTRYINDEX);
+        }
+
+        // Time slicer is non-copyable
+        TimeSlicer(const TimeSlicer& other) = delete;
+        TimeSlicer& operator=(const TimeSlicer&) = delete;
+
+        /// Adds script to end of queue, it starts in runSlice or run function
+        ///
+        /// @param function Lua function, for example state["handleRequest"]
+        /// @param onFinish Called with returned values when script finishes
+        ///
+        /// @return Identifier of script, it is valid until script finishes
+        uint64_t submit(const Value& function, const FinishHandler& onFinish = FinishHandler()) {
+            uint64_t id = _nextId++;
+            Task* task = new Task(id, function, onFinish);
+            _tasks[id].reset(task);
+
+            lua_sethook(task->coroutine.getThread(), &sliceHook, LUA_MASKCOUNT, _quantum);
+            _queue.push_back(id);
+            return id;
+        }
+
+        /// Removes script, it will not be resumed anymore
+        ///
+        /// @return false when script doesn't exist
+        bool cancel(uint64_t id) {
+            return _tasks.erase(id) > 0;
+        }
+
+        /// Runs first script in queue for one quantum. Preempted or yielded script is moved to end of queue.
+        ///
+        /// @throws lua::RuntimeError   When there is runtime error in script, script is then removed
+        ///
+        /// @return false when there is no script to run
+        bool runSlice() {
+            while (!_queue.empty()) {
+                uint64_t id = _queue.front();
+                _queue.pop_front();
+
+                // Canceled scripts are skipped
+                auto found = _tasks.find(id);
+                if (found == _tasks.end())
+                    continue;
+
+                Task& task = *found->second;
+                ++_slices;
+                _current = task.coroutine.getThread();
+
+                try {
+                    Value result = task.coroutine.resume();
+                    _current = nullptr;
+
+                    if (task.coroutine.status() != Coroutine::Dead) {
+                        _queue.push_back(id);
+                        return true;
+                    }
+
+                    if (task.onFinish)
+                        task.onFinish(id, result);
+                } catch (...) {
+                    _current = nullptr;
+                    remove(id);
+                    throw;
+                }
+
+                remove(id);
+                return true;
+            }
+            return false;
+        }
+
+        /// Runs all scripts until they finish
+        ///
+        /// @throws lua::RuntimeError   When there is runtime error in script, run can be called again
+        void run() {
+            while (runSlice());
+        }
+
+        /// @return Number of scripts which are not finished
+        size_t size() const { return _tasks.size(); }
+
+        /// @return Number of executed slices
+        uint64_t slices() const { return _slices; }
+
+        /// @return Number of times when script was preempted by hook
+        uint64_t preemptions() const { return _preemptions; }
+    };
+}
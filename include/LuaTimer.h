@@ -0,0 +1,366 @@
+//
+//  LuaTimer.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <unordered_map>
+#include <vector>
+
+namespace lua {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Intrusive node of timer wheel. Owner of node is found with static_cast from derived class.
+    struct TimerNode
+    {
+        uint64_t expires;
+        TimerNode* prev;
+        TimerNode* next;
+
+        TimerNode() : expires(0), prev(nullptr), next(nullptr) {}
+
+        bool isScheduled() const { return next != nullptr; }
+
+        void unlink() {
+            if (next != nullptr) {
+                prev->next = next;
+                next->prev = prev;
+                prev = next = nullptr;
+            }
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Hierarchical timer wheel with tick resolution. Every level has 256 slots, first level contains timers which
+    /// expire in next 256 ticks, next levels cover 256 times longer ranges and their timers are moved to lower levels
+    /// when their slot is reached. Scheduling and canceling of timer is O(1).
+    class TimerWheel
+    {
+    public:
+
+        static const unsigned LevelBits = 8;
+        static const unsigned SlotCount = 1 << LevelBits;
+        static const unsigned LevelCount = 4;
+
+    private:
+
+        /// Slots are circular lists with sentinel nodes
+        TimerNode _slots[LevelCount][SlotCount];
+
+        uint64_t _now;
+        size_t _size;
+
+        static void append(TimerNode& list, TimerNode& node) {
+            node.prev = list.prev;
+            node.next = &list;
+            list.prev->next = &node;
+            list.prev = &node;
+        }
+
+        /// Moves all nodes from slot to temporary list
+        static void detach(TimerNode& list, TimerNode& detached) {
+            if (list.next == &list) {
+                detached.prev = detached.next = &detached;
+                return;
+            }
+
+            detached.next = list.next;
+            detached.prev = list.prev;
+            detached.next->prev = &detached;
+            detached.prev->next = &detached;
+            list.prev = list.next = &list;
+        }
+
+        void insert(TimerNode& node) {
+            unsigned level = 0;
+            while (level + 1 < LevelCount && (node.expires >> (level * LevelBits)) - (_now >> (level * LevelBits)) >= SlotCount)
+                ++level;
+
+            append(_slots[level][(node.expires >> (level * LevelBits)) & (SlotCount - 1)], node);
+        }
+
+        /// Moves timers from slot of higher level to lower levels
+        void cascade(unsigned level) {
+            TimerNode detached;
+            detach(_slots[level][(_now >> (level * LevelBits)) & (SlotCount - 1)], detached);
+
+            while (detached.next != &detached) {
+                TimerNode* node = detached.next;
+                node->unlink();
+                insert(*node);
+            }
+        }
+
+    public:
+
+        TimerWheel() : _now(0), _size(0) {
+            for (unsigned level = 0; level < LevelCount; ++level) {
+                for (unsigned slot = 0; slot < SlotCount; ++slot)
+                    _slots[level][slot].prev = _slots[level][slot].next = &_slots[level][slot];
+            }
+        }
+
+        // Wheel is non-copyable, because nodes are pointing to its slots
+        TimerWheel(const TimerWheel& other) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        /// Schedules timer, already scheduled timer is rescheduled
+        ///
+        /// @param node     Timer node
+        /// @param expires  Tick when timer expires, past ticks mean next tick
+        void schedule(TimerNode& node, uint64_t expires) {
+            cancel(node);
+
+            node.expires = expires > _now ? expires : _now + 1;
+            insert(node);
+            ++_size;
+        }
+
+        /// Cancels scheduled timer, nothing is done when timer is not scheduled
+        void cancel(TimerNode& node) {
+            if (node.isScheduled()) {
+                node.unlink();
+                --_size;
+            }
+        }
+
+        /// Advances time by one tick and appends expired timers to given list. Expired timers are not scheduled.
+        void advance(std::vector<TimerNode*>& expired) {
+            ++_now;
+
+            // Higher levels are moved first, their timers can end up in lower level slots which are moved next
+            for (unsigned level = LevelCount - 1; level > 0; --level) {
+                if ((_now & ((uint64_t(1) << (level * LevelBits)) - 1)) == 0)
+                    cascade(level);
+            }
+
+            TimerNode detached;
+            detach(_slots[0][_now & (SlotCount - 1)], detached);
+
+            while (detached.next != &detached) {
+                TimerNode* node = detached.next;
+                node->unlink();
+                --_size;
+                expired.push_back(node);
+            }
+        }
+
+        /// @return Current tick
+        uint64_t now() const { return _now; }
+
+        /// @return Number of scheduled timers
+        size_t size() const { return _size; }
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs coroutines of one state, which are waiting for time. Sleeping coroutines are kept in timer wheel and
+    /// expired coroutines are resumed in batch on every tick. Lua functions sleep(seconds), yield() and
+    /// waitUntil(predicate) are set to state.
+    class CoroutineScheduler
+    {
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        struct Task : public TimerNode
+        {
+            uint64_t id;
+            Coroutine coroutine;
+
+            Task(uint64_t id, const Value& function) : id(id), coroutine(function) {}
+        };
+
+        State& _state;
+        double _tickSeconds;
+
+        TimerWheel _wheel;
+
+        std::unordered_map<uint64_t, std::unique_ptr<Task>> _tasks;
+        std::unordered_map<lua_State*, Task*> _threads;
+        uint64_t _nextId;
+
+        /// Time which was not converted to ticks yet
+        double _remainder;
+
+        /// Expired timers and their coroutines, kept to reuse memory
+        std::vector<TimerNode*> _expired;
+        std::vector<uint64_t> _batch;
+
+        static CoroutineScheduler* self(lua_State* luaState) {
+            return static_cast<CoroutineScheduler*>(lua_touserdata(luaState, lua_upvalueindex(1)));
+        }
+
+        static int sleepFunction(lua_State* luaState) {
+            CoroutineScheduler* scheduler = self(luaState);
+            double seconds = luaL_checknumber(luaState, 1);
+
+            auto found = scheduler->_threads.find(luaState);
+            if (found == scheduler->_threads.end())
+                return luaL_error(luaState, "sleep must be called from coroutine of scheduler");
+
+            double ticks = std::ceil(seconds / scheduler->_tickSeconds);
+            scheduler->_wheel.schedule(*found->second, scheduler->_wheel.now() + (ticks > 1 ? static_cast<uint64_t>(ticks) : 1));
+            return lua_yield(luaState, 0);
+        }
+
+        static int yieldFunction(lua_State* luaState) {
+            CoroutineScheduler* scheduler = self(luaState);
+
+            auto found = scheduler->_threads.find(luaState);
+            if (found == scheduler->_threads.end())
+                return luaL_error(luaState, "yield must be called from coroutine of scheduler");
+
+            scheduler->_wheel.schedule(*found->second, scheduler->_wheel.now() + 1);
+            return lua_yield(luaState, 0);
+        }
+
+        /// Resumes task, task is removed when it finishes or fails
+        ///
+        /// @return Exception thrown from coroutine
+        template <typename ... Ts>
+        std::exception_ptr resume(Task& task, Ts... args) {
+            try {
+                task.coroutine.resume(args...);
+            } catch (...) {
+                remove(task);
+                return std::current_exception();
+            }
+
+            if (task.coroutine.status() == Coroutine::Dead)
+                remove(task);
+
+            // Coroutine yielded with coroutine.yield, so it is resumed in next tick
+            else if (!task.isScheduled())
+                _wheel.schedule(task, _wheel.now() + 1);
+
+            return nullptr;
+        }
+
+        void remove(Task& task) {
+            _wheel.cancel(task);
+            _threads.erase(task.coroutine.getThread());
+            _tasks.erase(task.id);
+        }
+
+    public:
+
+        /// Sets sleep, yield and waitUntil functions to state
+        ///
+        /// @param state        State where coroutines will run
+        /// @param tickSeconds  Duration of one tick, sleep time is rounded up to ticks
+        CoroutineScheduler(State& state, double tickSeconds = 1.0 / 60)
+        : _state(state)
+        , _tickSeconds(tickSeconds)
+        , _nextId(1)
+        , _remainder(0)
+        {
+            lua_State* luaState = _state.getState();
+
+            lua_pushlightuserdata(luaState, this);
+            lua_pushcclosure(luaState, &sleepFunction, 1);
+            lua_setglobal(luaState, "sleep");
+
+            lua_pushlightuserdata(luaState, this);
+            lua_pushcclosure(luaState, &yieldFunction, 1);
+            lua_setglobal(luaState, "yield");
+
+            // Predicate is checked in coroutine once per tick
+            luaL_loadstring(luaState, "local yield = ... return function(predicate) while not predicate() do yield() end end");
+            lua_getglobal(luaState, "yield");
+            lua_call(luaState, 1, 1);
+            lua_setglobal(luaState, "waitUntil");
+        }
+
+        // Scheduler is non-copyable
+        CoroutineScheduler(const CoroutineScheduler& other) = delete;
+        CoroutineScheduler& operator=(const CoroutineScheduler&) = delete;
+
+        /// Starts coroutine, it runs until it waits or finishes
+        ///
+        /// @param function Lua function, for example state["patrol"]
+        /// @param args     Arguments of function
+        ///
+        /// @throws lua::RuntimeError   When there is runtime error in coroutine
+        ///
+        /// @return Identifier of coroutine, it is valid until coroutine finishes
+        template <typename ... Ts>
+        uint64_t spawn(const Value& function, Ts... args) {
+            uint64_t id = _nextId++;
+            Task* task = new Task(id, function);
+            _tasks[id].reset(task);
+            _threads[task->coroutine.getThread()] = task;
+
+            std::exception_ptr error = resume(*task, args...);
+            if (error)
+                std::rethrow_exception(error);
+            return id;
+        }
+
+        /// Removes coroutine, it will not be resumed anymore
+        ///
+        /// @note Running coroutine can't cancel itself
+        /// @return false when coroutine doesn't exist
+        bool cancel(uint64_t id) {
+            auto found = _tasks.find(id);
+            if (found == _tasks.end())
+                return false;
+
+            remove(*found->second);
+            return true;
+        }
+
+        /// Advances time by one tick and resumes all coroutines which are waiting for this tick
+        ///
+        /// @throws lua::RuntimeError   First error from resumed coroutines, all coroutines are resumed before it is thrown
+        ///
+        /// @return Number of resumed coroutines
+        size_t tick() {
+            _expired.clear();
+            _wheel.advance(_expired);
+
+            // Coroutine can be canceled by other coroutine from same batch, so they are found by identifiers
+            _batch.clear();
+            for (TimerNode* node : _expired)
+                _batch.push_back(static_cast<Task*>(node)->id);
+
+            std::exception_ptr firstError;
+            for (uint64_t id : _batch) {
+                auto found = _tasks.find(id);
+                if (found == _tasks.end())
+                    continue;
+
+                std::exception_ptr error = resume(*found->second);
+                if (error && !firstError)
+                    firstError = error;
+            }
+
+            if (firstError)
+                std::rethrow_exception(firstError);
+            return _batch.size();
+        }
+
+        /// Advances time by given seconds, one tick is done for every elapsed tick duration
+        ///
+        /// @return Number of resumed coroutines
+        size_t advance(double seconds) {
+            _remainder += seconds;
+
+            size_t resumed = 0;
+            while (_remainder >= _tickSeconds) {
+                _remainder -= _tickSeconds;
+                resumed += tick();
+            }
+            return resumed;
+        }
+
+        /// @return Current tick
+        uint64_t now() const { return _wheel.now(); }
+
+        /// @return Number of coroutines which are not finished
+        size_t size() const { return _tasks.size(); }
+    };
+}
@@ -0,0 +1,180 @@
+//
+//  LuaTransfer.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include "./LuaState.h"
+
+#include <stdexcept>
+
+namespace lua {
+
+    namespace detail {
+
+        /// Tables nested deeper are not copied, so C stack can't overflow
+        static const int MaxTransferDepth = 200;
+
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        /// Copies values from stack of one Lua state to stack of other Lua state
+        class ValueTransfer
+        {
+            lua_State* _from;
+            lua_State* _to;
+
+            /// Index of table in destination, which maps source tables to their copies
+            int _copies;
+
+            /// @return true when table was already copied and its copy was pushed
+            bool pushCopy(const void* table) {
+                lua_pushlightuserdata(_to, const_cast<void*>(table));
+                lua_rawget(_to, _copies);
+                if (!lua_isnil(_to, -1))
+                    return true;
+
+                lua_pop(_to, 1);
+                return false;
+            }
+
+            void copyTable(int index, int depth) {
+                const void* table = lua_topointer(_from, index);
+                if (pushCopy(table))
+                    return;
+
+                if (depth > MaxTransferDepth || !lua_checkstack(_from, 3) || !lua_checkstack(_to, 4))
+                    throw std::overflow_error("table is nested too deeply");
+
+                // Table is counted first, so copy is allocated with final size
+#if LUA_VERSION_NUM > 501
+                int arrayCount = static_cast<int>(lua_rawlen(_from, index));
+#else
+                int arrayCount = static_cast<int>(lua_objlen(_from, index));
+#endif
+                int count = 0;
+                lua_pushnil(_from);
+                while (lua_next(_from, index)) {
+                    lua_pop(_from, 1);
+                    ++count;
+                }
+
+                lua_createtable(_to, arrayCount, count > arrayCount ? count - arrayCount : 0);
+
+                // Copy is registered before its content, so cycles are pointing to it
+                lua_pushlightuserdata(_to, const_cast<void*>(table));
+                lua_pushvalue(_to, -2);
+                lua_rawset(_to, _copies);
+
+                lua_pushnil(_from);
+                while (lua_next(_from, index)) {
+                    int top = lua_gettop(_from);
+                    copy(top - 1, depth + 1);
+                    copy(top, depth + 1);
+                    lua_rawset(_to, -3);
+                    lua_pop(_from, 1);
+                }
+            }
+
+        public:
+
+            /// @param copies   Index of empty table in destination, which will be used for copies of tables
+            ValueTransfer(lua_State* from, lua_State* to, int copies)
+            : _from(from)
+            , _to(to)
+            , _copies(copies)
+            {
+            }
+
+            /// Pushes copy of value to destination stack
+            ///
+            /// @param index    Absolute index of value in source stack
+            void copy(int index, int depth = 0) {
+                switch (lua_type(_from, index)) {
+                    case LUA_TNIL:
+                        lua_pushnil(_to);
+                        break;
+
+                    case LUA_TBOOLEAN:
+                        lua_pushboolean(_to, lua_toboolean(_from, index));
+                        break;
+
+                    case LUA_TNUMBER:
+#if LUA_VERSION_NUM > 502
+                        if (lua_isinteger(_from, index)) {
+                            lua_pushinteger(_to, lua_tointeger(_from, index));
+                            break;
+                        }
+#endif
+                        lua_pushnumber(_to, lua_tonumber(_from, index));
+                        break;
+
+                    case LUA_TSTRING: {
+                        size_t length;
+                        const char* string = lua_tolstring(_from, index, &length);
+                        lua_pushlstring(_to, string, length);
+                        break;
+                    }
+
+                    case LUA_TLIGHTUSERDATA:
+                        lua_pushlightuserdata(_to, lua_touserdata(_from, index));
+                        break;
+
+                    case LUA_TTABLE:
+                        copyTable(index, depth);
+                        break;
+
+                    case LUA_TFUNCTION:
+                        // C functions without upvalues don't depend on source state
+                        if (lua_iscfunction(_from, index)) {
+                            if (lua_getupvalue(_from, index, 1) == nullptr) {
+                                lua_pushcfunction(_to, lua_tocfunction(_from, index));
+                                break;
+                            }
+                            lua_pop(_from, 1);
+                        }
+                        throw TypeMismatchError(_from, index);
+
+                    default:
+                        throw TypeMismatchError(_from, index);
+                }
+            }
+        };
+    }
+
+    /// Copies value to other state. Tables are copied deeply with shared and cyclic references preserved, without
+    /// converting them to text. Metatables are not copied.
+    ///
+    /// @note Neither state can be used by other thread during transfer
+    ///
+    /// @throws lua::TypeMismatchError  When value contains Lua function, userdata or thread
+    /// @throws std::overflow_error     When tables are nested more than 200 levels
+    ///
+    /// @param source       Value of source state
+    /// @param destination  State where value will be copied
+    ///
+    /// @return Copy of value on stack of destination state
+    inline Value transfer(const Value& source, State& destination) {
+        lua_State* from = source._stack->state;
+        lua_State* to = destination._luaState;
+
+        int fromTop = lua_gettop(from);
+        int toTop = lua_gettop(to);
+
+        lua_checkstack(to, 2);
+        lua_newtable(to);
+
+        try {
+            detail::ValueTransfer transfer(from, to, toTop + 1);
+            transfer.copy(source._stack->top + source._stack->pushed - source._stack->grouped);
+        } catch (...) {
+            lua_settop(from, fromTop);
+            lua_settop(to, toTop);
+            throw;
+        }
+
+        // Copies table is removed, only copy of value stays on stack
+        lua_remove(to, toTop + 1);
+        return Value(std::make_shared<detail::StackItem>(to, destination._deallocQueue, toTop, 1, 0));
+    }
+}
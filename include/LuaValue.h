@@ -13,7 +13,11 @@ namespace lua {
     class Value;
     class State;
     class Ref;
+    class Coroutine;
+    class StringBuilder;
     template <typename ... Ts> class Return;
+    
+    inline Value transfer(const Value& source, State& destination);
 
     //////////////////////////////////////////////////////////////////////////////////////////////
     /// This is class for:
@@ -25,7 +29,10 @@ namespace lua {
     {
         friend class State;
         friend class Ref;
+        friend class Coroutine;
+        friend class StringBuilder;
         template <typename ... Ts> friend class Return;
+        friend Value transfer(const Value& source, State& destination);
         
         std::shared_ptr<detail::StackItem> _stack;
         
@@ -48,9 +55,11 @@ namespace lua {
             
             stack::push(_stack->state, args...);
             
+            detail::WatchdogScope watchdogScope(_stack->state);
             if (protectedCall) {
-                if (lua_pcall(_stack->state, sizeof...(Ts), LUA_MULTRET, 0))
-                    throw RuntimeError(_stack->state);
+                int status = lua_pcall(_stack->state, sizeof...(Ts), LUA_MULTRET, 0);
+                if (status != 0)
+                    detail::throw_call_error(_stack->state, status);
             }
             else
                 lua_call(_stack->state, sizeof...(Ts), LUA_MULTRET);
@@ -235,6 +244,68 @@ namespace lua {
             return _stack->top + 1;
         }
         
+        /// Serializes value to compact binary format. Strings and tables which occur more times are written once,
+        /// so shared and cyclic tables are restored by State::deserialize. Metatables are not serialized.
+        ///
+        /// @throws lua::TypeMismatchError  When value contains function, userdata or thread
+        /// @throws std::overflow_error     When tables are nested more than 200 levels
+        ///
+        /// @param buffer   Buffer for serialized data, it is passed to output whenever it is full
+        /// @param size     Size of buffer
+        /// @param output   Function receiving serialized data
+        ///
+        /// @return Number of serialized bytes
+        size_t serialize(char* buffer, size_t size, const OutputFunction& output) const {
+            assert(size > 0);
+            int stackTop = stack::top(_stack->state);
+            
+            detail::BufferWriter writer(buffer, size, output);
+            writer.write(detail::serialized::Magic, sizeof(detail::serialized::Magic));
+            
+            try {
+                detail::Serializer serializer(_stack->state, writer);
+                serializer.write(_stack->top + _stack->pushed - _stack->grouped);
+            } catch (...) {
+                lua_settop(_stack->state, stackTop);
+                throw;
+            }
+            
+            writer.flush();
+            return writer.written();
+        }
+        
+        /// Serializes value to compact binary format, see serialize function with buffer
+        ///
+        /// @return Serialized data
+        std::string serialize() const {
+            std::string data;
+            char buffer[4096];
+            serialize(buffer, sizeof(buffer), [&data](const char* chunk, size_t size) { data.append(chunk, size); });
+            return data;
+        }
+        
+        /// Writes value as JSON. Tables with keys from 1 to n are arrays, other tables are objects with string or
+        /// number keys. Nil and light userdata NULL are written as null.
+        ///
+        /// @throws lua::TypeMismatchError  When value contains function, userdata, thread or table key of other type
+        /// @throws std::overflow_error     When tables are nested more than 200 levels or they are cyclic
+        /// @throws std::runtime_error      When value contains NaN or infinity
+        ///
+        /// @return JSON text
+        std::string toJson() const {
+            std::string json;
+            int stackTop = stack::top(_stack->state);
+            
+            try {
+                detail::json::Writer writer(_stack->state, json);
+                writer.write(_stack->top + _stack->pushed - _stack->grouped);
+            } catch (...) {
+                lua_settop(_stack->state, stackTop);
+                throw;
+            }
+            return json;
+        }
+        
         //////////////////////////////////////////////////////////////////////////////////////////////
         // Conventional conversion functions
 
@@ -345,6 +416,32 @@ namespace lua {
             lua_settable(_stack->state, _stack->top + _stack->pushed - _stack->grouped);
         }
         
+        /// Iterator over entries of table, see TableIterator
+        ///
+        /// @note Tables are iterated in order of lua_next, other values have no entries
+        TableIterator begin() const {
+            int index = _stack->top + _stack->pushed - _stack->grouped;
+            if (!lua_istable(_stack->state, index))
+                return TableIterator();
+            return TableIterator(_stack->state, index);
+        }
+        
+        TableIterator end() const {
+            return TableIterator();
+        }
+        
+        /// Calls function with key and value of each table entry, they are lua::StackSlot views, which are valid
+        /// only during call. Stack is restored after iteration.
+        ///
+        /// @param function     Function taking key and value
+        template<typename Function>
+        void forEach(Function function) const {
+            for (TableIterator iterator = begin(); iterator != end(); ++iterator) {
+                TableEntry entry = *iterator;
+                function(entry.key, entry.value);
+            }
+        }
+        
         int length() const {
 #if LUA_VERSION_NUM > 501
             return lua_rawlen(_stack->state, _stack->top + _stack->pushed - _stack->grouped);
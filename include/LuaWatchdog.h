@@ -0,0 +1,146 @@
+//
+//  LuaWatchdog.h
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#pragma once
+
+#include <chrono>
+
+namespace lua { namespace detail {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Instruction and wall clock budget of calls from C++ to Lua. Budget is counted from outermost call, calls
+    /// from bound C++ functions back to Lua are part of it.
+    struct Watchdog
+    {
+        /// Maximum number of instructions of one call, zero means no limit
+        unsigned long long instructionLimit;
+
+        /// Maximum duration of one call, zero means no limit
+        double secondsLimit;
+
+        /// Number of instructions between hook calls
+        int granularity;
+
+        unsigned long long executed;
+        std::chrono::steady_clock::time_point deadline;
+
+        /// Number of nested calls from C++
+        int depth;
+
+        /// Set when budget was exceeded in current call
+        bool timedOut;
+        const char* reason;
+
+        Watchdog()
+        : instructionLimit(0)
+        , secondsLimit(0)
+        , granularity(1000)
+        , executed(0)
+        , depth(0)
+        , timedOut(false)
+        , reason("")
+        {
+        }
+
+        void start() {
+            executed = 0;
+            timedOut = false;
+            if (secondsLimit > 0)
+                deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(secondsLimit));
+        }
+    };
+
+    /// Key of watchdog pointer in LUA_REGISTRYINDEX
+    inline void* watchdog_key() {
+        static const char key = 0;
+        return const_cast<char*>(&key);
+    }
+
+    /// @return Watchdog of state or nullptr
+    inline Watchdog* find_watchdog(lua_State* luaState) {
+        lua_pushlightuserdata(luaState, watchdog_key());
+        lua_rawget(luaState, LUA_REGISTRYINDEX);
+        Watchdog* watchdog = static_cast<Watchdog*>(lua_touserdata(luaState, -1));
+        lua_pop(luaState, 1);
+        return watchdog;
+    }
+
+    /// Adds instructions executed since last hook call and checks budget. Hooks which replace watchdog hook on
+    /// thread call it, so limits still apply there.
+    ///
+    /// @return true when budget is exceeded, reason of watchdog is set
+    inline bool watchdog_exceeded(Watchdog* watchdog, int count) {
+        if (watchdog->timedOut)
+            return true;
+
+        watchdog->executed += count;
+        if (watchdog->instructionLimit != 0 && watchdog->executed > watchdog->instructionLimit)
+            watchdog->reason = "instruction budget exceeded";
+        else if (watchdog->secondsLimit > 0 && std::chrono::steady_clock::now() > watchdog->deadline)
+            watchdog->reason = "time budget exceeded";
+        else
+            return false;
+
+        watchdog->timedOut = true;
+        return true;
+    }
+
+    /// Count hook which raises error when budget is exceeded. After that hook is called for every instruction and
+    /// raises error again, so script can't continue by catching error with pcall.
+    inline void watchdogHook(lua_State* luaState, lua_Debug*) {
+        Watchdog* watchdog = find_watchdog(luaState);
+        if (watchdog == nullptr || watchdog->depth == 0)
+            return;
+
+        int count = lua_gethookcount(luaState);
+        if (watchdog_exceeded(watchdog, count)) {
+            lua_sethook(luaState, &watchdogHook, LUA_MASKCOUNT, 1);
+            luaL_error(luaState, "%s", watchdog->reason);
+            return;
+        }
+
+        // Thread could stay with hook of previous timed out call
+        if (count != watchdog->granularity)
+            lua_sethook(luaState, &watchdogHook, LUA_MASKCOUNT, watchdog->granularity);
+    }
+
+    /// @return true when watchdog hook is installed
+    inline bool has_watchdog(lua_State* luaState) {
+        return lua_gethook(luaState) == &watchdogHook;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    /// Starts budget when outermost call from C++ to Lua begins. Without watchdog it costs one lua_gethook call.
+    class WatchdogScope
+    {
+        Watchdog* _watchdog;
+
+        /// Depth before call. Errors in unprotected nested calls jump over their scopes, so depth is restored
+        /// instead of decremented when enclosing protected call returns.
+        int _depth;
+
+    public:
+
+        WatchdogScope(lua_State* luaState)
+        : _watchdog(has_watchdog(luaState) ? find_watchdog(luaState) : nullptr)
+        , _depth(0)
+        {
+            if (_watchdog != nullptr) {
+                _depth = _watchdog->depth++;
+                if (_depth == 0)
+                    _watchdog->start();
+            }
+        }
+
+        ~WatchdogScope() {
+            if (_watchdog != nullptr)
+                _watchdog->depth = _depth;
+        }
+
+        WatchdogScope(const WatchdogScope& other) = delete;
+        WatchdogScope& operator=(const WatchdogScope&) = delete;
+    };
+} }
@@ -0,0 +1,124 @@
+//
+//  allocator_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+struct CountingAllocator {
+    int allocations = 0;
+    int releases = 0;
+    
+    static void* allocate(void* userData, void* pointer, size_t oldSize, size_t newSize) {
+        CountingAllocator* allocator = static_cast<CountingAllocator*>(userData);
+        if (newSize == 0) {
+            if (pointer != nullptr)
+                ++allocator->releases;
+            free(pointer);
+            return nullptr;
+        }
+        if (pointer == nullptr)
+            ++allocator->allocations;
+        return realloc(pointer, newSize);
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void runWorkload(lua::State& state) {
+    state.doString(createVariables);
+    state.doString(createFunctions);
+    
+    assert(state["table"]["a"] == 'a');
+    assert(state["getNested"]()["table"]["one"] == 1);
+    
+    int counter = 0;
+    state.set("increment", [&counter](int value) { counter += value; });
+    state.doString("for i = 1, 100 do increment(1) end");
+    assert(counter == 100);
+    
+    state.doString(R"(
+        local parts = {}
+        for i = 1, 1000 do
+            parts[#parts + 1] = { index = i, name = 'item' .. i }
+        end
+        text = string.rep('a', 3)
+        collectgarbage()
+    )");
+    assert(state["text"] == std::string("aaa"));
+    
+    state.checkMemLeaks();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Pool allocator reuses released blocks of same size class
+    {
+        lua::PoolAllocator allocator;
+        void* first = allocator.reallocate(nullptr, 0, 24);
+        void* second = allocator.reallocate(nullptr, 0, 24);
+        assert(first != second);
+        
+        // Same size class
+        assert(allocator.reallocate(first, 24, 30) == first);
+        
+        allocator.reallocate(first, 30, 0);
+        assert(allocator.reallocate(nullptr, 0, 20) == first);
+        
+        // Big blocks and moving between size classes keep content
+        char* block = static_cast<char*>(allocator.reallocate(nullptr, 0, 8));
+        strcpy(block, "abcdefg");
+        block = static_cast<char*>(allocator.reallocate(block, 8, 1000));
+        assert(strcmp(block, "abcdefg") == 0);
+        block = static_cast<char*>(allocator.reallocate(block, 1000, 100));
+        assert(strcmp(block, "abcdefg") == 0);
+        allocator.reallocate(block, 100, 0);
+        
+        assert(allocator.slabMemory() == lua::PoolAllocator::DefaultSlabSize);
+    }
+    
+    // State owning pool allocator
+    {
+        lua::StateOptions options;
+        options.poolAllocator = true;
+        lua::State state(options);
+        runWorkload(state);
+    }
+    
+    // Node local pool allocator reserves memory in constructor
+    {
+        lua::PoolAllocator allocator(lua::PoolAllocator::DefaultSlabSize, lua::MemoryPlacement(true, true));
+        assert(allocator.slabMemory() == lua::PoolAllocator::DefaultSlabSize);
+        
+        lua::State state(&lua::PoolAllocator::allocate, &allocator);
+        runWorkload(state);
+    }
+    {
+        lua::StateOptions options;
+        options.poolAllocator = true;
+        options.poolPlacement = lua::MemoryPlacement(true, false, 256 * 1024);
+        lua::State state(options);
+        runWorkload(state);
+    }
+    
+    // State with custom allocation function
+    CountingAllocator counting;
+    {
+        lua::State state(&CountingAllocator::allocate, &counting);
+        runWorkload(state);
+        assert(counting.allocations > 0);
+    }
+    assert(counting.allocations == counting.releases);
+    
+    // User managed pool allocator
+    {
+        lua::PoolAllocator allocator;
+        lua::State state(&lua::PoolAllocator::allocate, &allocator);
+        runWorkload(state);
+        assert(allocator.slabMemory() > 0);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,101 @@
+//
+//  archive_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+#include <fstream>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char mathModule[] = R"(
+local M = {}
+function M.add(a, b) return a + b end
+return M
+)";
+
+static const char nestedModule[] = "return { name = ... }";
+
+static const char brokenModule[] = "return {";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    lua::ScriptArchive archive;
+    archive.add("math2", mathModule, sizeof(mathModule) - 1);
+    archive.add("game.nested", nestedModule, sizeof(nestedModule) - 1);
+    archive.add("broken", brokenModule, sizeof(brokenModule) - 1);
+    
+    assert(archive.size() == 3);
+    assert(archive.find("math2") != nullptr);
+    assert(archive.find("math") == nullptr);
+    assert(archive.find("game.nested") != nullptr);
+    
+    {
+        lua::State state;
+        state.addArchive(archive);
+        
+        // Module paths are pointing nowhere, so modules can be found only in archive
+        state.doString("package.path = ''; package.cpath = ''");
+        
+        state.doString("local m = require 'math2'; assert(m.add(1, 2) == 3)");
+        state.doString("local n = require 'game.nested'; assert(n.name == 'game.nested')");
+        
+        try {
+            state.doString("require 'missing'");
+            assert(false);
+        } catch (lua::RuntimeError ex) {
+            assert(strstr(ex.what(), "no module 'missing' in archives") != nullptr);
+        }
+        
+        try {
+            state.doString("require 'broken'");
+            assert(false);
+        } catch (lua::RuntimeError ex) {
+            printf("%s\n", ex.what());
+        }
+        
+        state.checkMemLeaks();
+    }
+    
+    // Archive image saved to file and memory mapped
+    {
+        std::ofstream archiveFile("test.luar", std::ios::out | std::ios::binary);
+        std::string image = archive.image();
+        archiveFile.write(image.data(), image.size());
+        archiveFile.close();
+        
+        lua::ScriptArchive mappedArchive;
+        assert(!mappedArchive.open("no_file_here"));
+        assert(mappedArchive.open("test.luar"));
+        assert(mappedArchive.size() == 3);
+        
+        // Mapping can't be replaced while entries are pointing to it
+        assert(!mappedArchive.open("test.luar"));
+        assert(mappedArchive.find("math2") != nullptr);
+        
+        lua::ScriptArchive embeddedArchive;
+        assert(embeddedArchive.load(image.data(), image.size()));
+        assert(!embeddedArchive.load(image.data(), 8));
+        
+        lua::State state;
+        state.addArchive(mappedArchive);
+        state.doString("package.path = ''; package.cpath = ''");
+        state.doString("local m = require 'math2'; assert(m.add(2, 2) == 4)");
+        
+        state.checkMemLeaks();
+    }
+    
+    // Searcher is installed when package library is opened later
+    {
+        lua::State state(false);
+        luaL_openlibs(state.getState());
+        state.addArchive(archive);
+        state.doString("local m = require 'math2'; assert(m.add(3, 2) == 5)");
+        
+        state.checkMemLeaks();
+    }
+    
+    return 0;
+}
@@ -0,0 +1,129 @@
+//
+//  arena_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+struct Resource {
+    static int refCounter;
+    Resource() { ++refCounter; }
+    ~Resource() { --refCounter; }
+};
+int Resource::refCounter = 0;
+
+static int collectResource(lua_State* luaState) {
+    delete *static_cast<Resource**>(lua_touserdata(luaState, 1));
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Arena allocator grows last block in place and releases memory at once
+    {
+        lua::ArenaAllocator allocator(1024);
+        char* block = static_cast<char*>(allocator.reallocate(nullptr, 0, 10));
+        strcpy(block, "arena");
+        assert(allocator.reallocate(block, 10, 100) == block);
+        
+        char* other = static_cast<char*>(allocator.reallocate(nullptr, 0, 10));
+        assert(other != block);
+        
+        // Block is moved when it is not last one
+        char* moved = static_cast<char*>(allocator.reallocate(block, 100, 200));
+        assert(moved != block);
+        assert(strcmp(moved, "arena") == 0);
+        
+        // Big block gets its own chunk
+        assert(allocator.reallocate(nullptr, 0, 4096) != nullptr);
+        assert(allocator.chunkMemory() > 4096);
+        
+        allocator.reset();
+        assert(allocator.chunkMemory() == 1024);
+    }
+    
+    // Arena state is closed normally
+    {
+        lua::StateOptions options;
+        options.arenaAllocator = true;
+        lua::State state(options);
+        state.doString(createVariables);
+        state.doString("local t = {} for i = 1, 10000 do t[i] = { i } end");
+        assert(state["table"]["a"] == 'a');
+        state.checkMemLeaks();
+    }
+    
+    // Arena state is discarded without closing
+    {
+        lua::StateOptions options;
+        options.arenaAllocator = true;
+        options.fastTeardown = true;
+        lua::State state(options);
+        state.doString(createVariables);
+        state.doString(createFunctions);
+        assert(state["getValues"]() == 1);
+        
+        // Finalizers of standard libraries don't force closing
+        assert(!lua::detail::has_finalizers(state.getState()));
+        state.checkMemLeaks();
+    }
+    
+    // Arena state with userdata finalized by C++ is closed
+    {
+        lua::StateOptions options;
+        options.arenaAllocator = true;
+        options.fastTeardown = true;
+        lua::State state(options);
+        lua_State* luaState = state.getState();
+        
+        *static_cast<Resource**>(lua_newuserdata(luaState, sizeof(Resource*))) = new Resource();
+        luaL_newmetatable(luaState, "test.Resource");
+        lua_pushcfunction(luaState, &collectResource);
+        lua_setfield(luaState, -2, "__gc");
+        lua_setmetatable(luaState, -2);
+        lua_setglobal(luaState, "resource");
+        
+        assert(Resource::refCounter == 1);
+        assert(lua::detail::has_finalizers(luaState));
+    }
+    assert(Resource::refCounter == 0);
+    
+    // Arena state with functors is closed, so captured values are destructed
+    {
+        lua::StateOptions options;
+        options.arenaAllocator = true;
+        options.fastTeardown = true;
+        lua::State state(options);
+        
+        std::shared_ptr<Resource> resource = std::make_shared<Resource>();
+        state.set("useResource", [resource]() {});
+        resource.reset();
+        assert(Resource::refCounter == 1);
+        state.checkMemLeaks();
+    }
+    assert(Resource::refCounter == 0);
+    
+    // User managed arena reused for more states
+    {
+        lua::ArenaAllocator allocator;
+        
+        lua::StateOptions options;
+        options.allocator = &lua::ArenaAllocator::allocate;
+        options.allocatorData = &allocator;
+        options.fastTeardown = true;
+        
+        for (int i = 0; i < 10; ++i) {
+            {
+                lua::State state(options);
+                state.doString("local t = {} for i = 1, 1000 do t[i] = 'item' .. i end");
+            }
+            allocator.reset();
+        }
+        assert(allocator.chunkMemory() == lua::ArenaAllocator::DefaultChunkSize);
+    }
+    
+    return 0;
+}
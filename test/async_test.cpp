@@ -0,0 +1,197 @@
+//
+//  async_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaAsync.h"
+
+#include <deque>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Loopback stand-in for asynchronous backend. Requests are echoed back from backend thread.
+class LoopbackBackend
+{
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::pair<int, lua::Completion<int>>> _requests;
+    bool _stopping;
+    std::thread _thread;
+    
+public:
+    
+    LoopbackBackend() : _stopping(false) {
+        _thread = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (;;) {
+                _condition.wait(lock, [this]() { return _stopping || !_requests.empty(); });
+                if (_requests.empty())
+                    break;
+                
+                std::pair<int, lua::Completion<int>> request = _requests.front();
+                _requests.pop_front();
+                
+                lock.unlock();
+                if (request.first < 0)
+                    request.second.fail("negative request");
+                else
+                    request.second(request.first * 2);
+                lock.lock();
+            }
+        });
+    }
+    
+    ~LoopbackBackend() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _condition.notify_one();
+        _thread.join();
+    }
+    
+    void send(int value, lua::Completion<int> done) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _requests.emplace_back(value, done);
+        _condition.notify_one();
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Thousands of coroutines are waiting for backend on one thread
+    {
+        lua::State state;
+        lua::EventLoop loop(state);
+        LoopbackBackend backend;
+        
+        loop.bind<int(int)>("request", [&backend](int value, lua::Completion<int> done) {
+            backend.send(value, done);
+        });
+        loop.bind<void()>("nothing", [](lua::Completion<void> done) {
+            done();
+        });
+        
+        state.doString(R"(
+            total = 0
+            function handle(value)
+                local first = request(value)
+                nothing()
+                local second = request(first)
+                total = total + second
+            end
+        )");
+        
+        for (int i = 0; i < 2000; ++i)
+            loop.spawn(state["handle"], i);
+        assert(loop.size() == 2000);
+        assert(loop.waiting() == 2000);
+        
+        loop.run();
+        assert(loop.size() == 0);
+        
+        // Sum of i * 4
+        int total = state["total"];
+        assert(total == 4 * 1999 * 2000 / 2);
+        state.checkMemLeaks();
+    }
+    
+    // Errors from backend are raised in coroutine and can be caught with pcall
+    {
+        lua::State state;
+        lua::EventLoop loop(state);
+        LoopbackBackend backend;
+        
+        loop.bind<int(int)>("request", [&backend](int value, lua::Completion<int> done) {
+            backend.send(value, done);
+        });
+        loop.bind<int()>("abandoned", [](lua::Completion<int> done) {
+        });
+        
+        state.doString(R"(
+            function caught()
+                local success, message = pcall(function() return request(-1) end)
+                result = message
+            end
+            function uncaught()
+                request(-1)
+            end
+            function abandon()
+                abandoned()
+            end
+        )");
+        
+        // Lua 5.1 can't yield across pcall
+#if LUA_VERSION_NUM > 501 || defined(LUAJIT_VERSION)
+        loop.spawn(state["caught"]);
+        loop.run();
+        std::string result = state["result"];
+        assert(result.find("negative request") != std::string::npos);
+#endif
+        
+        loop.spawn(state["uncaught"]);
+        try {
+            loop.run();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+            assert(std::string(ex.what()).find("negative request") != std::string::npos);
+        }
+        assert(loop.size() == 0);
+        
+        loop.spawn(state["abandon"]);
+        try {
+            loop.run();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+            assert(std::string(ex.what()).find("abandoned") != std::string::npos);
+        }
+        state.checkMemLeaks();
+    }
+    
+    // Coroutines yielding without asynchronous call are resumed in next poll
+    {
+        lua::State state;
+        lua::EventLoop loop(state);
+        state.doString("count = 0; function step() for i = 1, 3 do count = count + 1; coroutine.yield() end end");
+        
+        loop.spawn(state["step"]);
+        assert(state["count"] == 1);
+        loop.poll();
+        assert(state["count"] == 2);
+        loop.run();
+        assert(state["count"] == 3);
+        
+        // Coroutines after failed one are not lost
+        state.doString("function fail() coroutine.yield() error('failed') end");
+        loop.spawn(state["fail"]);
+        loop.spawn(state["step"]);
+        try {
+            loop.poll();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        assert(loop.size() == 1);
+        loop.run();
+        assert(state["count"] == 6);
+        
+        // Asynchronous function can't be called outside of event loop
+        loop.bind<void()>("nothing", [](lua::Completion<void> done) {
+            done();
+        });
+        try {
+            state.doString("nothing()");
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        state.checkMemLeaks();
+    }
+    
+    return 0;
+}
@@ -0,0 +1,126 @@
+//
+//  buffer_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaBuffer.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    static const char payload[] = "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n";
+
+    // Scripts read buffer without copying it
+    {
+        int released = 0;
+        {
+            lua::State state;
+            state.set("body", lua::Buffer(payload, sizeof(payload) - 1, [&released]() { ++released; }));
+
+            int length = state.doString("return #body");
+            assert(length == static_cast<int>(sizeof(payload) - 1));
+            assert(state.doString("return body:len()") == length);
+
+            // Methods have same indexes as string functions
+            bool valid = state.doString(R"(
+                local text = body:tostring()
+                local line = body:sub(1, body:find('\r\n') - 1)
+                return line:tostring() == 'GET /index.html HTTP/1.1'
+                    and body:byte(1) == string.byte('G')
+                    and select('#', body:byte(1, 3)) == 3
+                    and body:sub(-4):tostring() == text:sub(-4)
+                    and body:sub(5, 15):sub(2, 6):tostring() == text:sub(5, 15):sub(2, 6)
+                    and body:sub(10, 5):len() == 0
+                    and body:tostring(1, 3) == 'GET'
+                    and body:find('Host') == text:find('Host', 1, true)
+                    and select(2, body:find('Host')) == select(2, text:find('Host', 1, true))
+                    and body:find('missing') == nil
+                    and body:find('T', 3) == text:find('T', 3, true)
+                    and body:find(body:sub(5, 10)) == 5
+            )");
+            assert(valid);
+
+            // Metamethods and metatable are hidden from scripts
+            bool hidden = state.doString("return body.__gc == nil and body.__len == nil and getmetatable(body) == 'lua::Buffer'");
+            assert(hidden);
+
+            state.set("copy", state["body"]);
+            state.doString("body = nil collectgarbage()");
+            assert(released == 0);
+
+            // Memory is released when last view is collected
+            state.doString("copy = nil collectgarbage()");
+            assert(released == 1);
+        }
+        assert(released == 1);
+    }
+
+    // Arena state with buffers is closed, so memory is released
+    {
+        int released = 0;
+        {
+            lua::StateOptions options;
+            options.arenaAllocator = true;
+            options.fastTeardown = true;
+            lua::State state(options);
+            state.set("body", lua::Buffer(payload, sizeof(payload) - 1, [&released]() { ++released; }));
+        }
+        assert(released == 1);
+    }
+
+    // Views keep memory alive
+    {
+        int released = 0;
+        lua::Buffer view;
+        {
+            lua::Buffer buffer(payload, sizeof(payload) - 1, [&released]() { ++released; });
+            view = buffer.sub(4, 11);
+        }
+        assert(released == 0);
+        assert(std::string(view.data(), view.size()) == "/index.html");
+
+        view = lua::Buffer();
+        assert(released == 1);
+    }
+
+    // Buffers are passed to bound functions
+    {
+        lua::State state;
+        state.set("body", lua::Buffer(std::string(payload)));
+        state.set("count", [](lua::Buffer buffer) -> int {
+            int lines = 0;
+            for (size_t i = 0; i < buffer.size(); ++i)
+                lines += buffer.data()[i] == '\n';
+            return lines;
+        });
+
+        assert(state.doString("return count(body)") == 3);
+        assert(state.doString("return count(body:sub(1, 30))") == 1);
+        assert(state.doString("return count('a\\nb')") == 1);
+
+        lua::Value body = state["body"];
+        assert(body.is<lua::Buffer>());
+        assert(body.to<lua::Buffer>().size() == sizeof(payload) - 1);
+    }
+
+    // Large payload is not copied to Lua heap
+    {
+        std::string large(5 * 1024 * 1024, 'x');
+        large[large.size() - 1] = 'y';
+
+        lua::State state;
+        size_t before = static_cast<size_t>(lua_gc(state.getState(), LUA_GCCOUNT, 0));
+        state.set("large", lua::Buffer(large.data(), large.size()));
+        int position = state.doString("return large:find('y')");
+        size_t after = static_cast<size_t>(lua_gc(state.getState(), LUA_GCCOUNT, 0));
+
+        assert(position == static_cast<int>(large.size()));
+        assert(after - before < 64);
+
+        state.checkMemLeaks();
+    }
+
+    return 0;
+}
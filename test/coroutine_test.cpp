@@ -0,0 +1,145 @@
+//
+//  coroutine_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* createCoroutines = R"(
+
+function counter(start, step)
+    local value = start
+    while true do
+        local add = coroutine.yield(value, value * 2)
+        if add == nil then break end
+        value = value + step + add
+    end
+    return 'done'
+end
+
+function failing()
+    coroutine.yield(1)
+    error('failed')
+end
+
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Coroutine is resumed with arguments and yields values
+    {
+        lua::State state;
+        state.doString(createCoroutines);
+        
+        lua::Coroutine coroutine(state["counter"]);
+        assert(coroutine.status() == lua::Coroutine::Suspended);
+        
+        {
+            int value, doubled;
+            lua::tie(value, doubled) = coroutine.resume(10, 5);
+            assert(value == 10);
+            assert(doubled == 20);
+        }
+        assert(coroutine.isResumable());
+        
+        int value = coroutine.resume(1);
+        assert(value == 16);
+        
+        std::string result = coroutine.resume();
+        assert(result == "done");
+        assert(coroutine.status() == lua::Coroutine::Dead);
+        
+        try {
+            coroutine.resume();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        state.checkMemLeaks();
+    }
+    
+    // Errors are thrown and coroutine is dead
+    {
+        lua::State state;
+        state.doString(createCoroutines);
+        
+        lua::Coroutine coroutine(state["failing"]);
+        assert(coroutine.resume() == 1);
+        try {
+            coroutine.resume();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+            assert(std::string(ex.what()).find("failed") != std::string::npos);
+        }
+        assert(coroutine.status() == lua::Coroutine::Dead);
+        state.checkMemLeaks();
+    }
+    
+    // Running coroutine can't be resumed and stays usable
+    {
+        lua::State state;
+        std::unique_ptr<lua::Coroutine> coroutine;
+        bool thrown = false;
+        state.set("resumeSelf", [&coroutine, &thrown]() {
+            try {
+                coroutine->resume();
+            }
+            catch (lua::RuntimeError ex) {
+                thrown = std::string(ex.what()).find("non-suspended") != std::string::npos;
+            }
+        });
+        state.doString("function reentrant() resumeSelf() coroutine.yield(1) return 2 end");
+        
+        coroutine.reset(new lua::Coroutine(state["reentrant"]));
+        assert(coroutine->resume() == 1);
+        assert(thrown);
+        assert(coroutine->status() == lua::Coroutine::Suspended);
+        assert(coroutine->resume() == 2);
+        
+        coroutine.reset();
+        state.checkMemLeaks();
+    }
+    
+    // Many coroutines share one state and are pinned in registry
+    {
+        lua::State state;
+        state.doString(createCoroutines);
+        
+        std::vector<std::unique_ptr<lua::Coroutine>> coroutines;
+        for (int i = 0; i < 1000; ++i) {
+            coroutines.emplace_back(new lua::Coroutine(state["counter"]));
+            coroutines.back()->resume(i, 1);
+        }
+        state.doString("collectgarbage()");
+        
+        for (int i = 0; i < 1000; ++i) {
+            int value = coroutines[i]->resume(0);
+            assert(value == i + 1);
+        }
+        
+        lua::Coroutine moved(std::move(*coroutines[0]));
+        assert(moved.resume(0) == 2);
+        
+        coroutines.clear();
+        state.checkMemLeaks();
+    }
+    
+    // C++ function can be resumed as coroutine
+    {
+        lua::State state;
+        state.set("add", [](int a, int b) { return a + b; });
+        
+        lua::Coroutine coroutine(state["add"]);
+        assert(coroutine.resume(1, 2) == 3);
+        assert(coroutine.status() == lua::Coroutine::Dead);
+        state.checkMemLeaks();
+    }
+    
+    return 0;
+}
@@ -0,0 +1,143 @@
+//
+//  environment_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+#include <fstream>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Globals of environments are separated, shared globals are visible
+    {
+        lua::State state;
+        state.set("shared", 10);
+        state.set("add", [](int a, int b) { return a + b; });
+
+        lua::Environment first = state.createEnvironment();
+        lua::Environment second = state.createEnvironment();
+
+        state.doString("value = add(shared, 1)", first);
+        state.doString("value = add(shared, 2)", second);
+
+        assert(first["value"] == 11);
+        assert(second["value"] == 12);
+        assert(state["value"].is<lua::Nil>());
+
+        // Environment can shadow shared global
+        first.set("shared", 20);
+        int value = state.doString("return shared", first);
+        assert(value == 20);
+        assert(state["shared"] == 10);
+        assert(second["shared"] == 10);
+    }
+
+    // Scripts can't reach shared globals table
+    {
+        lua::State state;
+        lua::Environment environment = state.createEnvironment();
+
+        state.doString("_G.leaked = true; rawset(_G, 'alsoLeaked', true)", environment);
+        assert(state["leaked"].is<lua::Nil>());
+        assert(state["alsoLeaked"].is<lua::Nil>());
+        assert(environment["leaked"] == true);
+
+        bool hidden = state.doString("return getmetatable(_G) == false", environment);
+        assert(hidden);
+
+        // Libraries are shared
+        std::string upper = state.doString("return string.upper('abc')", environment);
+        assert(upper == "ABC");
+
+        lua::Value table = environment.table();
+        assert(table.is<lua::Table>());
+        assert(table["leaked"] == true);
+    }
+
+    // Compiled chunk is called many times without parsing
+    {
+        lua::State state;
+
+        lua::Value increment = state.compile("counter = (counter or 0) + 1 return counter");
+        assert(increment.is<lua::Callable>());
+        increment.call();
+        increment.call();
+        assert(state["counter"] == 2);
+
+        lua::Environment environment = state.createEnvironment();
+        lua::Value isolated = state.compile("counter = (counter or 0) + 10 return counter", environment);
+        // Shared counter is read, but new value is stored to environment
+        int value = isolated.call();
+        assert(value == 12);
+        assert(environment["counter"] == 12);
+        assert(state["counter"] == 2);
+    }
+
+    // Files can run in environment
+    {
+        std::ofstream luaFile;
+        luaFile.open("environment_test.lua");
+        luaFile << "fileValue = 42 return fileValue";
+        luaFile.close();
+
+        lua::State state;
+        lua::Environment environment = state.createEnvironment();
+        int value = state.doFile("environment_test.lua", environment);
+        assert(value == 42);
+        assert(environment["fileValue"] == 42);
+        assert(state["fileValue"].is<lua::Nil>());
+    }
+
+    // Load errors are reported as for global scripts
+    {
+        lua::State state;
+        lua::Environment environment = state.createEnvironment();
+
+        bool thrown = false;
+        try {
+            state.compile("this is not lua", environment);
+        } catch (lua::LoadError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        thrown = false;
+        try {
+            state.doString("error('tenant failed')", environment);
+        } catch (lua::RuntimeError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+    // Many environments share one state
+    {
+        lua::State state;
+        state.doString("function greet(name) return 'hello ' .. name end");
+
+        std::vector<lua::Environment> tenants;
+        for (int i = 0; i < 1000; ++i) {
+            tenants.push_back(state.createEnvironment());
+            tenants.back().set("id", i);
+        }
+
+        for (int i = 0; i < 1000; ++i) {
+            int id = state.doString("return id", tenants[i]);
+            assert(id == i);
+        }
+
+        std::string greeting = state.doString("return greet('tenant')", tenants[5]);
+        assert(greeting == "hello tenant");
+
+        tenants.clear();
+        state.checkMemLeaks();
+    }
+
+    return 0;
+}
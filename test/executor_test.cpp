@@ -0,0 +1,111 @@
+//
+//  executor_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaStateExecutor.h"
+
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Queue keeps order of items
+    {
+        lua::detail::MpscQueue<int> queue;
+        int value;
+        assert(queue.empty());
+        assert(!queue.pop(value));
+        
+        queue.push(1);
+        queue.push(2);
+        assert(!queue.empty());
+        assert(queue.pop(value) && value == 1);
+        assert(queue.pop(value) && value == 2);
+        assert(queue.empty());
+        
+        // Items left in queue are destroyed
+        queue.push(3);
+    }
+    
+    // Functions are called on executor thread
+    {
+        lua::StateExecutor executor([](lua::State& state) {
+            state.doString(createVariables);
+            state.doString(createFunctions);
+            state.doString("function add(a, b) return a + b end");
+        });
+        
+        std::future<int> integer = executor.call<int>("getInteger");
+        std::future<int> sum = executor.call<int>("add", 1, 2);
+        std::future<std::string> text = executor.call<std::string>("tostring", "hello");
+        assert(integer.get() == 10);
+        assert(sum.get() == 3);
+        assert(text.get() == "hello");
+        
+        std::thread::id executorThread;
+        std::promise<void> done;
+        executor.post([&](lua::State& state) {
+            executorThread = std::this_thread::get_id();
+            state.checkMemLeaks();
+            done.set_value();
+        });
+        done.get_future().get();
+        assert(executorThread != std::this_thread::get_id());
+        
+        // Errors are passed through future
+        std::future<void> error = executor.call<void>("error", "failed");
+        try {
+            error.get();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+    }
+    
+    // Error in initialization is thrown from constructor
+    {
+        try {
+            lua::StateExecutor executor([](lua::State& state) {
+                state.doString("error('init')");
+            });
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+    }
+    
+    // Many producers drive one state, posted tasks are executed before executor is destroyed
+    {
+        std::vector<std::future<int>> results;
+        {
+            lua::StateExecutor executor([](lua::State& state) {
+                state.doString("counter = 0; function increment() counter = counter + 1; return counter end");
+            }, lua::StateOptions(), 16);
+            
+            std::vector<std::thread> threads;
+            std::mutex resultsMutex;
+            for (int i = 0; i < 4; ++i) {
+                threads.emplace_back([&]() {
+                    for (int j = 0; j < 250; ++j) {
+                        std::future<int> result = executor.call<int>("increment");
+                        std::lock_guard<std::mutex> lock(resultsMutex);
+                        results.push_back(std::move(result));
+                    }
+                });
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+        }
+        
+        int maximum = 0;
+        for (std::future<int>& result : results)
+            maximum = std::max(maximum, result.get());
+        assert(maximum == 1000);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,207 @@
+//
+//  ffi_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaFFI.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+struct Particle
+{
+    float position[3];
+    double mass;
+    int32_t id;
+    bool active;
+};
+
+struct Sparse
+{
+    char tag;
+    void* internal;
+    uint16_t flags;
+    int64_t hidden;
+};
+
+struct Wide
+{
+    int32_t first;
+    double hidden;
+    int32_t last;
+};
+
+struct Tail
+{
+    double hidden;
+    int32_t value;
+};
+
+static double scale(double value, int32_t factor) { return value * factor; }
+static bool isPositive(float value) { return value > 0; }
+static void increment(void* counter) { ++*static_cast<int*>(counter); }
+static long wide(long value) { return value; }
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    lua::FFIStruct<Particle> particle("Particle");
+    particle.field("position", &Particle::position)
+            .field("mass", &Particle::mass)
+            .field("id", &Particle::id)
+            .field("active", &Particle::active);
+
+    // Declaration is generated from fields
+    {
+        std::string expected = "typedef struct { float position[3]; double mass; int32_t id; bool active; } Particle;";
+        assert(particle.declaration() == expected);
+    }
+
+    // Undeclared members are replaced with padding
+    {
+        lua::FFIStruct<Sparse> sparse("Sparse");
+        sparse.field("flags", &Sparse::flags).field("tag", &Sparse::tag);
+
+        std::string expected = "typedef struct { char tag; uint8_t _padding0[" + std::to_string(offsetof(Sparse, flags) - 1) + "];"
+            + " uint16_t flags; uint8_t _padding1[" + std::to_string(sizeof(Sparse) - offsetof(Sparse, flags) - 2) + "]; } Sparse;";
+        assert(sparse.declaration() == expected);
+    }
+
+    // Tail is padded when alignment of struct comes from undeclared member
+    {
+        lua::FFIStruct<Wide> wide("Wide");
+        wide.field("first", &Wide::first).field("last", &Wide::last);
+        assert(wide.declaration() == "typedef struct { int32_t first; uint8_t _padding0[12]; int32_t last; uint8_t _padding1[4]; } Wide;");
+
+        lua::FFIStruct<Tail> tail("Tail");
+        tail.field("value", &Tail::value);
+        assert(tail.declaration() == "typedef struct { uint8_t _padding0[8]; int32_t value; uint8_t _padding1[4]; } Tail;");
+    }
+
+    // Function pointer declarations are generated from signatures
+    {
+        std::string declaration = lua::detail::ffi::function_pointer_declaration<double, double, int32_t, lua::Pointer>();
+        assert(declaration == "double (*)(double, int32_t, void*)");
+        assert(lua::detail::ffi::function_pointer_declaration<void>() == "void (*)(void)");
+    }
+
+    // Arena state with pointer anchors is closed, so release functions are called
+    {
+        int released = 0;
+        {
+            lua::StateOptions options;
+            options.arenaAllocator = true;
+            options.fastTeardown = true;
+            lua::State state(options);
+
+            lua::detail::ffi::Release anchor;
+            anchor.function = [&released]() { ++released; };
+            state.set("anchor", anchor);
+        }
+        assert(released == 1);
+    }
+
+    // Functions are called same way through FFI and Functor
+    {
+        lua::State state;
+        bool ffi = lua::setFFIFunction(state, "scale", &scale);
+        lua::setFFIFunction(state, "isPositive", &isPositive);
+        lua::setFFIFunction(state, "increment", &increment);
+
+        // 64-bit integers and lambdas always use Functor
+        assert(!lua::setFFIFunction(state, "wide", &wide));
+        assert(!lua::setFFIFunction(state, "add", [](int first, int second) { return first + second; }));
+
+#ifdef LUAJIT_VERSION
+        assert(ffi);
+#else
+        assert(!ffi);
+#endif
+
+        int counter = 0;
+        state.set("counter", static_cast<lua::Pointer>(&counter));
+        bool valid = state.doString(R"(
+            increment(counter)
+            return scale(1.5, 4) == 6 and isPositive(2) == true and isPositive(-1) == false
+                and wide(5) == 5 and add(2, 3) == 5
+        )");
+        assert(valid);
+        assert(counter == 1);
+
+        state.checkMemLeaks();
+    }
+
+#ifdef LUAJIT_VERSION
+
+    // Scripts change C++ array through cdata
+    {
+        std::vector<Particle> particles(100);
+        for (size_t i = 0; i < particles.size(); ++i) {
+            particles[i].id = static_cast<int32_t>(i);
+            particles[i].mass = 1;
+        }
+
+        int released = 0;
+        {
+            lua::State state;
+            state.set("particles", particle.pointer(state, particles.data(), [&released]() { ++released; }));
+            state.set("count", static_cast<int>(particles.size()));
+
+            state.doString(R"(
+                for i = 0, count - 1 do
+                    local p = particles[i]
+                    p.position[1] = p.id * 2
+                    p.mass = p.mass + 0.5
+                    p.active = p.id % 2 == 0
+                end
+            )");
+            assert(released == 0);
+
+            state.doString("particles = nil collectgarbage() collectgarbage()");
+            assert(released == 1);
+        }
+
+        assert(particles[10].position[1] == 20);
+        assert(particles[99].mass == 1.5);
+        assert(particles[4].active && !particles[5].active);
+    }
+
+    // Anchor is kept alive while pointer is used
+    {
+        lua::State state;
+        Particle single = Particle();
+        state.doString("weak = setmetatable({ owner = {} }, { __mode = 'v' })");
+        {
+            lua::Ref anchor = state["weak"]["owner"];
+            state.set("pointer", particle.pointer(state, &single, anchor));
+        }
+
+        bool alive = state.doString("collectgarbage() pointer.id = 7 return weak.owner ~= nil");
+        assert(alive);
+        assert(single.id == 7);
+
+        bool collected = state.doString("pointer = nil collectgarbage() collectgarbage() return weak.owner == nil");
+        assert(collected);
+    }
+
+#else
+
+    // Plain Lua has no FFI library
+    {
+        lua::State state;
+
+        bool thrown = false;
+        try {
+            particle.declare(state);
+        } catch (lua::RuntimeError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+#endif
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+//
+//  iteration_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+#include <map>
+#include <stdexcept>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    lua::State state;
+    lua_State* luaState = state.getState();
+    state.doString(R"(
+        config = { name = 'server', port = 8080, ratio = 0.5, enabled = true, 10, 20, 30, [2.5] = 'half' }
+        nested = { first = { 1, 2 }, second = { 3, 4, 5 } }
+        empty = {}
+    )");
+
+    // All entries are visited with typed keys and values
+    {
+        lua::Value config = state["config"];
+        int top = lua_gettop(luaState);
+
+        std::map<std::string, std::string> strings;
+        int count = 0;
+        lua::Number sum = 0;
+        config.forEach([&](const lua::StackSlot& key, const lua::StackSlot& value) {
+            ++count;
+            if (key.type() == LUA_TSTRING && value.type() == LUA_TSTRING)
+                strings[key.toString()] = value.toString();
+            if (key.type() == LUA_TNUMBER && value.is<lua::Number>())
+                sum += key.toNumber() * value.toNumber();
+
+            // Number keys can be read as strings, lua_next still gets same key
+            std::string text = key;
+            assert(!text.empty());
+        });
+
+        assert(count == 8);
+        assert(strings.size() == 1 && strings["name"] == "server");
+        assert(sum == 10 + 2 * 20 + 3 * 30);
+        assert(lua_gettop(luaState) == top);
+    }
+
+    // Range for loop gives key and value views
+    {
+        lua::Value config = state["config"];
+        int top = lua_gettop(luaState);
+
+        int port = 0;
+        bool enabled = false;
+        int numberKeys = 0;
+        for (lua::TableEntry entry : config) {
+            const char* key = entry.key.toCStr();
+            if (key == nullptr)
+                ++numberKeys;
+            else if (std::string(key) == "port")
+                port = entry.value;
+            else if (std::string(key) == "enabled")
+                enabled = entry.value.toBool();
+        }
+        assert(port == 8080 && enabled && numberKeys == 4);
+        assert(lua_gettop(luaState) == top);
+
+        // Break and exceptions restore stack
+        for (lua::TableEntry entry : config) {
+            if (entry.key.is<lua::String>())
+                break;
+        }
+        assert(lua_gettop(luaState) == top);
+
+        bool thrown = false;
+        try {
+            config.forEach([](const lua::StackSlot& key, const lua::StackSlot& value) {
+                throw std::runtime_error("stop");
+            });
+        } catch (std::runtime_error ex) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(lua_gettop(luaState) == top);
+    }
+
+    // Nested tables are iterated with values created in step
+    {
+        int top = lua_gettop(luaState);
+        int total = 0;
+        state["nested"].forEach([&](const lua::StackSlot& key, const lua::StackSlot& value) {
+            lua::Value list = state["nested"][key.toCStr()];
+            list.forEach([&](const lua::StackSlot& index, const lua::StackSlot& number) {
+                total += number.toInt();
+            });
+        });
+        assert(total == 15);
+        assert(lua_gettop(luaState) == top);
+    }
+
+    // Empty tables and other values have no entries
+    {
+        int top = lua_gettop(luaState);
+        int count = 0;
+        for (const lua::TableEntry& entry : state["empty"])
+            count += entry.key.type() != LUA_TNIL;
+        for (const lua::TableEntry& entry : state["config"]["port"])
+            count += entry.key.type() != LUA_TNIL;
+        state["missing"].forEach([&](const lua::StackSlot&, const lua::StackSlot&) { ++count; });
+        assert(count == 0);
+        assert(lua_gettop(luaState) == top);
+    }
+
+    state.checkMemLeaks();
+    return 0;
+}
@@ -0,0 +1,148 @@
+//
+//  json_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+#include <stdexcept>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* document = R"(
+{
+    "name": "pipeline",
+    "enabled": true,
+    "disabled": false,
+    "ratio": 0.25,
+    "count": -42,
+    "large": 12345678901234567890,
+    "huge": -1234567890123456789012345,
+    "exponent": 1.5e3,
+    "stages": ["parse", "filter", "store", null, []],
+    "escaped": "quote \" backslash \\ slash \/ tab \t newline \n unicode \u00e9 \ud83d\ude00",
+    "long string without escapes which is longer than sixteen bytes": {},
+    "nested": { "deeper": { "deepest": [1, 2, [3]] } }
+}
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // JSON is parsed to tables
+    {
+        lua::State state;
+        state.set("config", state.pushJson(document, strlen(document)));
+
+        bool valid = state.doString(R"(
+            return config.name == 'pipeline' and config.enabled == true and config.disabled == false
+                and config.ratio == 0.25 and config.count == -42 and config.large == 12345678901234567890
+                and config.huge == -1234567890123456789012345
+                and config.exponent == 1500
+                and #config.stages == 5 and config.stages[3] == 'store' and type(config.stages[4]) == 'userdata'
+                and next(config.stages[5]) == nil
+                and config.escaped == 'quote " backslash \\ slash / tab \t newline \n unicode \195\169 \240\159\152\128'
+                and next(config['long string without escapes which is longer than sixteen bytes']) == nil
+                and config.nested.deeper.deepest[3][1] == 3
+        )");
+        assert(valid);
+
+        state.checkMemLeaks();
+    }
+
+    // Scalars can be documents
+    {
+        lua::State state;
+        assert(state.pushJson("  12  ") == 12);
+        assert(state.pushJson("\"text\"") == std::string("text"));
+        assert(state.pushJson("true") == true);
+        assert(state.pushJson("null").is<lua::Pointer>());
+
+        state.checkMemLeaks();
+    }
+
+    // Values are written as JSON
+    {
+        lua::State state;
+        state.doString(R"(
+            array = { 1, 2.5, 'three', true, false }
+            object = { key = 'value' }
+            escaped = 'line\nquote"\1'
+            nested = { list = { { id = 1 } } }
+        )");
+
+        assert(state["array"].toJson() == "[1,2.5,\"three\",true,false]");
+        assert(state["object"].toJson() == "{\"key\":\"value\"}");
+        assert(state["escaped"].toJson() == "\"line\\nquote\\\"\\u0001\"");
+        assert(state["nested"].toJson() == "{\"list\":[{\"id\":1}]}");
+        assert(state["missing"].toJson() == "null");
+
+        state.checkMemLeaks();
+    }
+
+    // Parsed document is written back with same values
+    {
+        lua::State state;
+        std::string json = state.pushJson(document, strlen(document)).toJson();
+        state.set("first", state.pushJson(json));
+        state.set("second", state.pushJson(state["first"].toJson()));
+
+        bool same = state.doString("return first.escaped == second.escaped and first.nested.deeper.deepest[2] == 2 and first.stages[4] == second.stages[4]");
+        assert(same);
+
+        state.checkMemLeaks();
+    }
+
+    // Invalid JSON is refused
+    {
+        lua::State state;
+        const char* invalid[] = { "", "{", "[1,]", "{\"a\" 1}", "[1 2]", "tru", "01", "1.", "\"unterminated", "\"\\x\"", "{} []", "[\"\\ud800\"]", "{1: 2}" };
+
+        for (const char* json : invalid) {
+            bool thrown = false;
+            try {
+                state.pushJson(json);
+            } catch (std::runtime_error ex) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+
+        std::string deep(1000, '[');
+        bool thrown = false;
+        try {
+            state.pushJson(deep);
+        } catch (std::overflow_error ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+    // Values which can't be written are refused
+    {
+        lua::State state;
+        state.doString("cyclic = {} cyclic.self = cyclic functions = { print }");
+
+        bool thrown = false;
+        try {
+            state["cyclic"].toJson();
+        } catch (std::overflow_error ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        thrown = false;
+        try {
+            state["functions"].toJson();
+        } catch (lua::TypeMismatchError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+    return 0;
+}
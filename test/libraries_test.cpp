@@ -0,0 +1,96 @@
+//
+//  libraries_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static bool isGlobalOpened(lua::State& state, const char* name) {
+    lua_State* luaState = state.getState();
+#if LUA_VERSION_NUM > 501
+    lua_rawgeti(luaState, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+    lua_pushvalue(luaState, LUA_GLOBALSINDEX);
+#endif
+    lua_pushstring(luaState, name);
+    lua_rawget(luaState, -2);
+    bool opened = !lua_isnil(luaState, -1);
+    lua_pop(luaState, 2);
+    return opened;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char testModule[] = "return 'from archive'";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Only selected libraries are opened
+    {
+        lua::State state(lua::StateOptions(lua::lib::Base | lua::lib::String | lua::lib::Table));
+        
+        assert(state["string"].is<lua::Table>());
+        assert(state["table"].is<lua::Table>());
+        assert(state["io"].is<lua::Nil>());
+        assert(state["os"].is<lua::Nil>());
+        assert(state["debug"].is<lua::Nil>());
+        assert(state["require"].is<lua::Nil>());
+        
+        state.doString("assert(string.rep('a', 3) == 'aaa')");
+        state.checkMemLeaks();
+    }
+    
+    // No libraries
+    {
+        lua::State state(lua::StateOptions(lua::lib::None));
+        assert(state["print"].is<lua::Nil>());
+        state.checkMemLeaks();
+    }
+    
+    // Lazy libraries are opened on first access
+    {
+        lua::State state(lua::StateOptions(lua::lib::Base | lua::lib::String | lua::lib::Table | lua::lib::Package, true));
+        
+        assert(isGlobalOpened(state, "print"));
+        assert(!isGlobalOpened(state, "string"));
+        assert(!isGlobalOpened(state, "table"));
+        
+        state.doString("t = {}; table.insert(t, 10); assert(t[1] == 10)");
+        assert(isGlobalOpened(state, "table"));
+        assert(!isGlobalOpened(state, "string"));
+        
+        // Methods of strings will open string library
+        state.doString("assert(('%d'):format(5) == '5')");
+        assert(isGlobalOpened(state, "string"));
+        
+        // Not selected libraries are not opened
+        state.doString("assert(io == nil and os == nil)");
+        assert(!isGlobalOpened(state, "io"));
+        
+        // Package library is opened with require and it finds modules in archives
+        lua::ScriptArchive archive;
+        archive.add("lazy", testModule, sizeof(testModule) - 1);
+        state.addArchive(archive);
+        assert(isGlobalOpened(state, "package"));
+        state.doString("assert(require 'lazy' == 'from archive')");
+        
+        state.checkMemLeaks();
+    }
+    
+    // Archive searcher installed with lazy package library
+    {
+        lua::State state(lua::StateOptions(lua::lib::All, true));
+        
+        lua::ScriptArchive archive;
+        archive.add("lazy", testModule, sizeof(testModule) - 1);
+        state.addArchive(archive);
+        state.doString("assert(require 'lazy' == 'from archive')");
+        state.doString("assert(type(package.loaders or package.searchers) == 'table')");
+        
+        state.checkMemLeaks();
+    }
+    
+    return 0;
+}
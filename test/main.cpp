@@ -43,6 +43,29 @@ int main(int argc, char** argv)
     runTest("state_test");
     runTest("types_test");
     runTest("values_test");
+    runTest("archive_test");
+    runTest("libraries_test");
+    runTest("allocator_test");
+    runTest("memory_test");
+    runTest("arena_test");
+    runTest("pool_test");
+    runTest("executor_test");
+    runTest("scheduler_test");
+    runTest("coroutine_test");
+    runTest("async_test");
+    runTest("timer_test");
+    runTest("watchdog_test");
+    runTest("timeslice_test");
+    runTest("environment_test");
+    runTest("transfer_test");
+    runTest("serialize_test");
+    runTest("json_test");
+    runTest("buffer_test");
+    runTest("stringbuilder_test");
+    runTest("numericarray_test");
+    runTest("ffi_test");
+    runTest("proxy_test");
+    runTest("iteration_test");
     
     return 0;
 }
@@ -0,0 +1,113 @@
+//
+//  memory_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Memory statistics
+    {
+        lua::StateOptions options;
+        options.trackMemory = true;
+        lua::State state(options);
+        
+        lua::MemoryStats stats = state.memoryStats();
+        assert(stats.liveBytes > 0);
+        assert(stats.peakBytes >= stats.liveBytes);
+        assert(stats.limit == 0);
+        assert(stats.allocations > stats.releases);
+        
+        // Live bytes are same as Lua counts them
+        lua_State* luaState = state.getState();
+        assert(stats.liveBytes == static_cast<size_t>(lua_gc(luaState, LUA_GCCOUNT, 0)) * 1024 + lua_gc(luaState, LUA_GCCOUNTB, 0));
+        
+        size_t allocations = 0;
+        for (size_t i = 0; i < lua::MemoryStats::BucketCount; ++i)
+            allocations += stats.allocationsBySize[i];
+        assert(allocations == stats.allocations);
+        
+        state.doString("big = string.rep('a', 100000)");
+        assert(state.memoryStats().allocationsBySize[lua::MemoryStats::BucketCount - 1] > 0);
+        
+        size_t peak = state.memoryStats().peakBytes;
+        state.doString("big = nil; collectgarbage()");
+        assert(state.memoryStats().liveBytes < peak - 100000);
+        assert(state.memoryStats().peakBytes >= peak);
+        
+        state.checkMemLeaks();
+    }
+    
+    // Memory limit
+    {
+        lua::StateOptions options;
+        options.memoryLimit = 1024 * 1024;
+        options.poolAllocator = true;
+        lua::State state(options);
+        
+        assert(state.memoryStats().limit == 1024 * 1024);
+        
+        try {
+            state.doString("local t = {} for i = 1, 1000000 do t[i] = 'item' .. i end");
+            assert(false);
+        } catch (lua::MemoryError ex) {
+            printf("%s\n", ex.what());
+        }
+        assert(state.memoryStats().failedAllocations > 0);
+        assert(state.memoryStats().liveBytes <= 1024 * 1024);
+        
+        // Garbage of failed script is released
+        lua_gc(state.getState(), LUA_GCCOLLECT, 0);
+        state.doString("function allocate(count) local t = {} for i = 1, count do t[i] = 'item' .. i end return #t end");
+        try {
+            state["allocate"].call(1000000);
+            assert(false);
+        } catch (lua::RuntimeError& ex) {
+            assert(dynamic_cast<lua::MemoryError*>(&ex) != nullptr);
+        }
+        
+        // State can be still used
+        lua_gc(state.getState(), LUA_GCCOLLECT, 0);
+        assert(state["allocate"].call(100) == 100);
+        
+        // Limit can be changed
+        state.setMemoryLimit(0);
+        assert(state["allocate"].call(100000) == 100000);
+        
+        state.checkMemLeaks();
+    }
+    
+    // Memory statistics of untracked state
+    {
+        lua::State state;
+        assert(state.memoryStats().liveBytes > 0);
+        assert(state.memoryStats().allocations == 0);
+        
+        // Limit needs tracking allocator
+        bool thrown = false;
+        try {
+            state.setMemoryLimit(1024 * 1024);
+        } catch (std::runtime_error& ex) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    
+    // Limit smaller than base state
+    {
+        lua::StateOptions options;
+        options.memoryLimit = 64;
+        bool thrown = false;
+        try {
+            lua::State state(options);
+        } catch (std::runtime_error& ex) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,204 @@
+//
+//  numericarray_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaNumericArray.h"
+
+#include <stdexcept>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Scripts index array like table
+    {
+        lua::State state;
+        state.set("values", lua::NumericArray<double>(std::vector<double>{ 1.5, 2.5, 3.5 }));
+
+        bool valid = state.doString(R"(
+            values[2] = 10
+            return #values == 3 and values:len() == 3 and values[1] == 1.5 and values[2] == 10
+                and values[0] == nil and values[4] == nil and getmetatable(values) == 'lua::NumericArray<double>'
+        )");
+        assert(valid);
+
+        bool thrown = false;
+        try {
+            state.doString("values[4] = 1");
+        } catch (lua::RuntimeError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+    // Wrapped vector is changed by scripts without copying
+    {
+        std::vector<float> elements(37);
+        for (size_t i = 0; i < elements.size(); ++i)
+            elements[i] = static_cast<float>(i);
+
+        int released = 0;
+        {
+            lua::State state;
+            state.set("values", lua::NumericArray<float>::wrap(elements, [&released]() { ++released; }));
+
+            bool valid = state.doString(R"(
+                local sum = values:sum()
+                local low, high = values:min(), values:max()
+                values:scale(2)
+                values:map('add', 1)
+                return sum == 666 and low == 0 and high == 36 and values[37] == 73
+            )");
+            assert(valid);
+            assert(released == 0);
+        }
+        assert(released == 1);
+        assert(elements[0] == 1 && elements[36] == 73);
+
+        // Arena state with arrays is closed, so release function is called
+        {
+            lua::StateOptions options;
+            options.arenaAllocator = true;
+            options.fastTeardown = true;
+            lua::State state(options);
+            state.set("values", lua::NumericArray<float>::wrap(elements, [&released]() { ++released; }));
+        }
+        assert(released == 2);
+    }
+
+    // Kernels give same results as Lua loops for all element types and odd sizes
+    {
+        lua::State state;
+        state.doString(R"(
+            function check(first, second)
+                local sum, dot, low, high = 0, 0, math.huge, -math.huge
+                for i = 1, #first do
+                    sum = sum + first[i]
+                    dot = dot + first[i] * second[i]
+                    low = math.min(low, first[i])
+                    high = math.max(high, first[i])
+                end
+                if first:sum() ~= sum or first:dot(second) ~= dot or first:min() ~= low or first:max() ~= high then
+                    return false
+                end
+
+                local expected = {}
+                for i = 1, #first do expected[i] = math.max(first[i] + 3 * second[i], 5) end
+                first:axpy(3, second)
+                first:map('max', 5)
+                for i = 1, #first do
+                    if first[i] ~= expected[i] then return false end
+                end
+                return true
+            end
+        )");
+
+        for (int size : { 1, 2, 3, 7, 8, 9, 31, 100 }) {
+            std::vector<double> doubles;
+            std::vector<float> floats;
+            std::vector<int32_t> ints;
+            std::vector<int64_t> longs;
+            for (int i = 0; i < size; ++i) {
+                int value = (i * 7) % 13 - 6;
+                doubles.push_back(value);
+                floats.push_back(static_cast<float>(value));
+                ints.push_back(value);
+                longs.push_back(value);
+            }
+
+            bool valid = state["check"](lua::NumericArray<double>(doubles), lua::NumericArray<double>(doubles));
+            assert(valid);
+            valid = state["check"](lua::NumericArray<float>(floats), lua::NumericArray<float>(floats));
+            assert(valid);
+            valid = state["check"](lua::NumericArray<int32_t>(ints), lua::NumericArray<int32_t>(ints));
+            assert(valid);
+            valid = state["check"](lua::NumericArray<int64_t>(longs), lua::NumericArray<int64_t>(longs));
+            assert(valid);
+        }
+
+        state.checkMemLeaks();
+    }
+
+    // Map operations and integer division
+    {
+        lua::NumericArray<int32_t> array(std::vector<int32_t>{ 10, -20, 30 });
+        array.map(lua::NumericArray<int32_t>::Operation::Divide, 10);
+        array.map(lua::NumericArray<int32_t>::Operation::Subtract, 1);
+        array.map(lua::NumericArray<int32_t>::Operation::Min, 1);
+        assert(array[0] == 0 && array[1] == -3 && array[2] == 1);
+
+        bool thrown = false;
+        try {
+            array.map(lua::NumericArray<int32_t>::Operation::Divide, 0);
+        } catch (std::invalid_argument ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        lua::State state;
+        state.set("values", array);
+        thrown = false;
+        try {
+            state.doString("values:map('div', 0)");
+        } catch (lua::RuntimeError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        // Minimum divided by -1 doesn't fit to type
+        lua::NumericArray<int32_t> minimum(std::vector<int32_t>{ 1, std::numeric_limits<int32_t>::min() });
+        thrown = false;
+        try {
+            minimum.map(lua::NumericArray<int32_t>::Operation::Divide, -1);
+        } catch (std::overflow_error ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.set("minimum", minimum);
+        thrown = false;
+        try {
+            state.doString("minimum:map('div', -1)");
+        } catch (lua::RuntimeError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(minimum[1] == std::numeric_limits<int32_t>::min());
+
+        state.doString("values:map('div', -1)");
+        assert(array[0] == 0 && array[1] == 3 && array[2] == -1);
+
+        thrown = false;
+        try {
+            state.doString("values:dot(values:totable())");
+        } catch (lua::RuntimeError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+    // Bound functions take arrays and tables
+    {
+        lua::State state;
+        state.set("total", [](lua::NumericArray<double> values) -> double { return values.sum(); });
+        state.set("values", lua::NumericArray<double>(std::vector<double>{ 1, 2, 3 }));
+
+        assert(state.doString("return total(values)") == 6);
+        assert(state.doString("return total({ 4, 5, 6 })") == 15);
+        assert(state.doString("return #values:totable()") == 3);
+
+        lua::NumericArray<double> values = state["values"];
+        values[0] = 100;
+        assert(state.doString("return values[1]") == 100);
+
+        state.checkMemLeaks();
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+//
+//  pool_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaStatePool.h"
+
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Index stack returns indexes in LIFO order
+    {
+        lua::detail::IndexStack stack(4);
+        uint32_t index;
+        assert(!stack.pop(index));
+        
+        stack.push(2);
+        stack.push(0);
+        assert(stack.pop(index) && index == 0);
+        assert(stack.pop(index) && index == 2);
+        assert(!stack.pop(index));
+    }
+    
+    // States are initialized and leased
+    {
+        lua::StatePool pool([](lua::State& state) {
+            state.doString(createVariables);
+            state.doString(createFunctions);
+        }, 2);
+        assert(pool.size() == 2);
+        assert(pool.idle() == 2);
+        
+        {
+            lua::StatePool::Lease lease = pool.acquire();
+            assert(lease.isValid());
+            assert(pool.idle() == 1);
+            
+            int value = (*lease)["getInteger"]();
+            assert(value == 10);
+            lease->checkMemLeaks();
+        }
+        assert(pool.idle() == 2);
+        
+        lua::StatePool::Lease first = pool.acquire();
+        lua::StatePool::Lease second = pool.acquire();
+        assert(first.operator->() != second.operator->());
+        
+        // Pool has fixed size
+        lua::StatePool::Lease third;
+        assert(!pool.tryAcquire(third));
+        assert(!third.isValid());
+        
+        lua::StatePool::Lease moved = std::move(first);
+        assert(!first.isValid());
+        moved.release();
+        assert(pool.tryAcquire(third));
+        
+        second.release();
+        third.release();
+        assert(pool.counters().acquisitions == 4);
+        assert(pool.counters().created == 2);
+    }
+    
+    // Globals are reset after state is returned
+    {
+        lua::StatePool::Options options(1);
+        options.resetGlobals = true;
+        
+        lua::StatePool pool([](lua::State& state) {
+            state.doString(createVariables);
+        }, options);
+        
+        {
+            lua::StatePool::Lease lease = pool.acquire();
+            lease->doString("integer = 20; text = nil; leaked = 'leaked'");
+            assert((*lease)["integer"] == 20);
+        }
+        {
+            lua::StatePool::Lease lease = pool.acquire();
+            assert((*lease)["integer"] == 10);
+            assert((*lease)["text"] == std::string("hello"));
+            assert((*lease)["leaked"].is<lua::Nil>());
+            
+            // Values of tables are not restored, only global table
+            assert((*lease)["table"]["a"] == 'a');
+            lease->checkMemLeaks();
+        }
+    }
+    
+    // Pool grows on demand and shrinks when states are idle
+    {
+        lua::StatePool::Options options(1);
+        options.maxSize = 3;
+        options.maxIdle = 1;
+        
+        lua::StatePool pool([](lua::State& state) {
+            state.set("ready", true);
+        }, options);
+        
+        {
+            lua::StatePool::Lease first = pool.acquire();
+            lua::StatePool::Lease second = pool.acquire();
+            lua::StatePool::Lease third = pool.acquire();
+            assert(pool.size() == 3);
+            assert((*second)["ready"] == true);
+            assert((*third)["ready"] == true);
+            
+            lua::StatePool::Lease fourth;
+            assert(!pool.tryAcquire(fourth));
+        }
+        assert(pool.size() == 1);
+        assert(pool.idle() == 1);
+        assert(pool.counters().destroyed == 2);
+    }
+    
+    // Failed initialization returns slot to pool
+    {
+        lua::StatePool::Options options(0);
+        options.maxSize = 1;
+        
+        bool fail = true;
+        lua::StatePool pool([&fail](lua::State& state) {
+            if (fail)
+                state.doString("error('init')");
+        }, options);
+        
+        try {
+            pool.acquire();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        
+        fail = false;
+        lua::StatePool::Lease lease = pool.acquire();
+        assert(lease.isValid());
+    }
+    
+    // States are shared between threads, every thread waits for free state
+    {
+        lua::StatePool pool([](lua::State& state) {
+            state.doString("counter = 0");
+        }, 2);
+        
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&pool]() {
+                for (int j = 0; j < 250; ++j) {
+                    lua::StatePool::Lease lease = pool.acquire();
+                    lease->doString("counter = counter + 1");
+                    if (j % 50 == 0)
+                        std::this_thread::yield();
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        
+        lua::StatePool::Lease first = pool.acquire();
+        lua::StatePool::Lease second = pool.acquire();
+        int firstCounter = (*first)["counter"];
+        int secondCounter = (*second)["counter"];
+        assert(firstCounter + secondCounter == 1000);
+        assert(pool.counters().acquisitions == 1002);
+    }
+    
+    return 0;
+}
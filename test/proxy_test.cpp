@@ -0,0 +1,134 @@
+//
+//  proxy_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaProxy.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Scripts read and change vector in place
+    {
+        std::vector<double> values = { 1.5, 2.5, 3.5 };
+        lua::State state;
+        state.set("values", lua::Proxy(values));
+
+        bool valid = state.doString(R"(
+            local sum = 0
+            for i, value in values() do sum = sum + i * value end
+            values[1] = 10
+            values[#values + 1] = 4.5
+            return sum == 1.5 + 5 + 10.5 and #values == 4 and values[2] == 2.5 and values[0] == nil and values.name == nil
+        )");
+        assert(valid);
+        assert(values.size() == 4 && values[0] == 10 && values[3] == 4.5);
+
+        // Changes in C++ are visible to scripts
+        values[1] = 20;
+        assert(state.doString("return values[2]") == 20);
+
+        const char* invalid[] = { "values[6] = 1", "values[1] = 'text'", "values.name = 1" };
+        for (const char* script : invalid) {
+            bool thrown = false;
+            try {
+                state.doString(script);
+            } catch (lua::RuntimeError ex) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+
+        state.checkMemLeaks();
+    }
+
+    // Maps are indexed and iterated by keys
+    {
+        std::map<std::string, int> ordered = { { "alpha", 1 }, { "beta", 2 }, { "gamma", 3 } };
+        std::unordered_map<int, std::string> hashed = { { 10, "ten" }, { 20, "twenty" }, { 30, "thirty" } };
+
+        lua::State state;
+        state.set("ordered", lua::Proxy(ordered));
+        state.set("hashed", lua::Proxy(hashed));
+
+        bool valid = state.doString(R"(
+            local keys = {}
+            for key, value in ordered() do keys[#keys + 1] = key .. value end
+
+            local count, total = 0, 0
+            for key, value in hashed() do
+                count = count + 1
+                total = total + key + #value
+            end
+
+            return table.concat(keys, ',') == 'alpha1,beta2,gamma3' and count == 3 and total == 60 + 3 + 6 + 6
+                and ordered.beta == 2 and ordered.delta == nil and ordered[1] == nil and hashed[20] == 'twenty'
+                and #ordered == 3
+        )");
+        assert(valid);
+
+        state.doString("ordered.delta = 4 ordered.alpha = nil hashed[10] = 'TEN' hashed[40] = 'forty'");
+        assert(ordered.size() == 3 && ordered["delta"] == 4 && ordered.count("alpha") == 0);
+        assert(hashed.size() == 4 && hashed[10] == "TEN" && hashed[40] == "forty");
+
+        bool thrown = false;
+        try {
+            state.doString("hashed.name = 'text'");
+        } catch (lua::RuntimeError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+#if LUA_VERSION_NUM > 501
+    // Pairs uses __pairs metamethod
+    {
+        std::map<int, int> squares = { { 1, 1 }, { 2, 4 }, { 3, 9 } };
+        lua::State state;
+        state.set("squares", lua::Proxy(squares));
+
+        int sum = state.doString("local sum = 0 for key, value in pairs(squares) do sum = sum + key + value end return sum");
+        assert(sum == 20);
+    }
+#endif
+
+    // Shared container lives while proxy is used
+    {
+        std::weak_ptr<std::vector<int>> weak;
+        {
+            lua::State state;
+            {
+                std::shared_ptr<std::vector<int>> numbers = std::make_shared<std::vector<int>>(3, 7);
+                weak = numbers;
+                state.set("numbers", lua::Proxy(numbers));
+            }
+            assert(!weak.expired());
+
+            // Bound functions take proxies
+            state.set("same", [](lua::Proxy proxy) { return proxy; });
+            assert(state.doString("return same(numbers)[3]") == 7);
+
+            state.doString("numbers = nil collectgarbage() collectgarbage()");
+            assert(weak.expired());
+        }
+
+        // Arena state with proxies is closed, so shared container is released
+        {
+            lua::StateOptions options;
+            options.arenaAllocator = true;
+            options.fastTeardown = true;
+            lua::State state(options);
+
+            std::shared_ptr<std::vector<int>> numbers = std::make_shared<std::vector<int>>(3, 7);
+            weak = numbers;
+            state.set("numbers", lua::Proxy(numbers));
+        }
+        assert(weak.expired());
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+//
+//  scheduler_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaScheduler.h"
+
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Every worker has initialized state
+    {
+        lua::Scheduler scheduler([](lua::State& state) {
+            state.doString(createVariables);
+            state.doString("function square(x) return x * x end");
+        }, 3);
+        assert(scheduler.size() == 3);
+        
+        std::atomic<int> sum(0);
+        for (int i = 0; i < 100; ++i) {
+            scheduler.submit([&sum](lua::State& state) {
+                int integer = state["integer"];
+                sum += integer;
+                state.checkMemLeaks();
+            });
+        }
+        scheduler.wait();
+        assert(sum == 1000);
+        assert(scheduler.executedJobs() == 100);
+        
+        // Results are in order of inputs
+        std::vector<int> inputs;
+        for (int i = 0; i < 1000; ++i)
+            inputs.push_back(i);
+        
+        std::vector<int> results = scheduler.parallelMap<int>("square", inputs);
+        assert(results.size() == inputs.size());
+        for (int i = 0; i < 1000; ++i)
+            assert(results[i] == i * i);
+        
+        std::vector<std::string> texts = scheduler.parallelMap<std::string>("tostring", inputs, 7);
+        assert(texts[999] == "999");
+        
+        assert(scheduler.parallelMap<int>("square", std::vector<int>()).empty());
+    }
+    
+    // Errors are thrown from wait and parallelMap
+    {
+        lua::Scheduler scheduler([](lua::State& state) {
+            state.doString("function check(x) if x == 50 then error('invalid') end return x end");
+        }, 2);
+        
+        scheduler.submit([](lua::State& state) {
+            state.doString("error('job')");
+        });
+        try {
+            scheduler.wait();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        
+        // Error is reported only once
+        scheduler.wait();
+        
+        std::vector<int> inputs(100);
+        for (int i = 0; i < 100; ++i)
+            inputs[i] = i;
+        try {
+            scheduler.parallelMap<int>("check", inputs);
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+    }
+    
+    // Idle workers steal jobs from busy ones
+    {
+        lua::Scheduler scheduler(lua::Scheduler::Initializer(), 2);
+        
+        std::atomic<int> count(0);
+        for (int i = 0; i < 200; ++i) {
+            scheduler.submit([&count](lua::State& state) {
+                state.doString("local x = 0 for i = 1, 1000 do x = x + i end");
+                ++count;
+            });
+        }
+        scheduler.wait();
+        assert(count == 200);
+    }
+    
+    // Error in initialization is thrown from constructor
+    {
+        try {
+            lua::Scheduler scheduler([](lua::State& state) {
+                state.doString("error('init')");
+            }, 2);
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,162 @@
+//
+//  serialize_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+#include <stdexcept>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* createInventory = R"(
+
+inventory = {
+    owner = 'player',
+    gold = 1500,
+    weight = 12.75,
+    negative = -300,
+    big = 2^40,
+    locked = false,
+    items = { 'sword', 'shield', 'potion', 'potion', 'potion' },
+    slots = { [1] = 'head', [2] = 'chest', [10] = 'ring', [2.5] = 'half' },
+    stats = { strength = { base = 10, bonus = 2 } },
+    binary = 'a\0b',
+}
+inventory.self = inventory
+inventory.equipped = inventory.items
+
+function check(copy)
+    return copy.owner == 'player' and copy.gold == 1500 and copy.weight == 12.75 and copy.negative == -300
+        and copy.big == 2^40 and copy.locked == false
+        and #copy.items == 5 and copy.items[5] == 'potion'
+        and copy.slots[1] == 'head' and copy.slots[10] == 'ring' and copy.slots[2.5] == 'half'
+        and copy.stats.strength.bonus == 2 and copy.binary == 'a\0b'
+        and copy.self == copy and copy.equipped == copy.items
+end
+
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Values are restored in other state
+    {
+        lua::State source;
+        lua::State destination;
+        source.doString(createInventory);
+
+        std::string data = source["inventory"].serialize();
+        destination.set("copy", destination.deserialize(data));
+
+        bool valid = source["check"](source.deserialize(data));
+        assert(valid);
+
+        assert(destination["copy"]["owner"] == std::string("player"));
+        assert(destination["copy"]["self"]["gold"] == 1500);
+
+        source.checkMemLeaks();
+        destination.checkMemLeaks();
+    }
+
+    // Primitives are serialized
+    {
+        lua::State state;
+
+        assert(state.deserialize(lua::Value(state["missing"]).serialize()).is<lua::Nil>());
+
+        state.set("value", 3.5);
+        assert(state.deserialize(state["value"].serialize()) == 3.5);
+
+        state.set("value", "text");
+        assert(state.deserialize(state["value"].serialize()) == std::string("text"));
+
+        state.set("value", true);
+        assert(state.deserialize(state["value"].serialize()) == true);
+
+        state.checkMemLeaks();
+    }
+
+    // Repeated strings and small integers are compact
+    {
+        lua::State state;
+        state.doString("names = {} for i = 1, 100 do names[i] = 'a rather long repeated name' end");
+
+        std::string data = state["names"].serialize();
+        assert(data.size() < 300);
+
+        state.doString("numbers = {} for i = 1, 100 do numbers[i] = i end");
+        data = state["numbers"].serialize();
+        assert(data.size() < 3 * 100);
+
+        state.checkMemLeaks();
+    }
+
+    // Streaming into small buffer gives same data
+    {
+        lua::State state;
+        state.doString(createInventory);
+
+        std::string streamed;
+        char buffer[7];
+        size_t flushes = 0;
+        size_t size = state["inventory"].serialize(buffer, sizeof(buffer), [&](const char* data, size_t length) {
+            assert(length <= sizeof(buffer));
+            streamed.append(data, length);
+            ++flushes;
+        });
+
+        assert(size == streamed.size());
+        assert(flushes > 1);
+
+        bool valid = state["check"](state.deserialize(streamed));
+        assert(valid);
+
+        state.checkMemLeaks();
+    }
+
+    // Functions can't be serialized
+    {
+        lua::State state;
+        state.doString("values = { 1, 2, { print } }");
+
+        bool thrown = false;
+        try {
+            state["values"].serialize();
+        } catch (lua::TypeMismatchError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+    // Corrupted data are refused
+    {
+        lua::State state;
+        state.doString(createInventory);
+        std::string data = state["inventory"].serialize();
+
+        for (size_t size = 0; size < data.size(); ++size) {
+            bool thrown = false;
+            try {
+                state.deserialize(data.data(), size);
+            } catch (std::runtime_error ex) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+
+        bool thrown = false;
+        try {
+            state.deserialize("LS\1\x07\xff\xff\xff\xff\x0f\x00");
+        } catch (std::runtime_error ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        state.checkMemLeaks();
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+//
+//  stringbuilder_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaStringBuilder.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Appended parts are joined to one string
+    {
+        lua::State state;
+        {
+            lua::StringBuilder builder(state);
+            builder.append("id=").appendInteger(-42).append(',').append(std::string("ratio=")).appendNumber(0.25);
+            builder.append("|bytes\0end", 10).appendFormat("|%05d|%s", 7, "x");
+
+            lua::Value value = builder.finish();
+            assert(value.is<lua::String>());
+            assert(value == std::string("id=-42,ratio=0.25|bytes"));
+
+            state.set("built", value);
+        }
+
+        bool equal = state.doString("return #built == 35 and built == 'id=-42,ratio=0.25|bytes\\0end|00007|x'");
+        assert(equal);
+
+        state.checkMemLeaks();
+    }
+
+    // String longer than internal buffer is built
+    {
+        lua::State state;
+        std::string expected;
+        {
+            lua::StringBuilder builder(state);
+            for (int i = 0; i < 10000; ++i) {
+                builder.appendInteger(i).append(' ');
+                expected += std::to_string(i) + ' ';
+            }
+
+            std::string longText(LUAL_BUFFERSIZE * 3, 'a');
+            builder.appendFormat("%s", longText.c_str());
+            expected += longText;
+
+            state.set("built", builder.finish());
+        }
+
+        assert(state["built"] == expected);
+        state.checkMemLeaks();
+    }
+
+    // Unfinished builder leaves stack as it was
+    {
+        lua::State state;
+        lua::Value number = state.doString("return 1");
+        {
+            lua::StringBuilder builder(state);
+            for (int i = 0; i < 10000; ++i)
+                builder.append("discarded text ");
+        }
+
+        assert(number == 1);
+        assert(lua_gettop(state.getState()) == 1);
+    }
+
+    return 0;
+}
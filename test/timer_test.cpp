@@ -0,0 +1,137 @@
+//
+//  timer_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaTimer.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Timers expire exactly in their tick, also after moving from higher levels
+    {
+        lua::TimerWheel wheel;
+        const uint64_t delays[] = { 1, 2, 255, 256, 257, 1000, 65535, 65536, 70000, 300000 };
+        const size_t count = sizeof(delays) / sizeof(delays[0]);
+        
+        lua::TimerNode nodes[count];
+        for (size_t i = 0; i < count; ++i)
+            wheel.schedule(nodes[i], delays[i]);
+        assert(wheel.size() == count);
+        
+        lua::TimerNode canceled;
+        wheel.schedule(canceled, 500);
+        wheel.cancel(canceled);
+        assert(!canceled.isScheduled());
+        assert(wheel.size() == count);
+        
+        std::vector<lua::TimerNode*> expired;
+        size_t next = 0;
+        while (wheel.now() < 300000) {
+            expired.clear();
+            wheel.advance(expired);
+            
+            for (lua::TimerNode* node : expired) {
+                assert(node == &nodes[next]);
+                assert(node->expires == wheel.now());
+                assert(!node->isScheduled());
+                ++next;
+            }
+        }
+        assert(next == count);
+        assert(wheel.size() == 0);
+        
+        // Past ticks are scheduled to next tick
+        wheel.schedule(nodes[0], 10);
+        expired.clear();
+        wheel.advance(expired);
+        assert(expired.size() == 1);
+    }
+    
+    // Coroutines sleep, yield and wait for conditions
+    {
+        lua::State state;
+        lua::CoroutineScheduler scheduler(state, 0.1);
+        
+        state.doString(R"(
+            log = {}
+            function sleeper(name, seconds)
+                sleep(seconds)
+                log[#log + 1] = name
+            end
+            function yielder()
+                for i = 1, 3 do
+                    yieldCount = i
+                    yield()
+                end
+            end
+            function waiter()
+                waitUntil(function() return ready end)
+                log[#log + 1] = 'ready'
+            end
+        )");
+        
+        scheduler.spawn(state["sleeper"], "late", 0.5);
+        scheduler.spawn(state["sleeper"], "early", 0.15);
+        scheduler.spawn(state["yielder"]);
+        scheduler.spawn(state["waiter"]);
+        uint64_t canceled = scheduler.spawn(state["sleeper"], "canceled", 0.3);
+        assert(scheduler.size() == 5);
+        assert(state["yieldCount"] == 1);
+        
+        assert(scheduler.cancel(canceled));
+        assert(!scheduler.cancel(canceled));
+        
+        scheduler.tick();
+        assert(state["yieldCount"] == 2);
+        assert(state["log"].length() == 0);
+        
+        scheduler.tick();
+        assert(state["log"][1] == std::string("early"));
+        
+        state.set("ready", true);
+        scheduler.advance(0.35);
+        assert(scheduler.now() == 5);
+        assert(state["log"][2] == std::string("ready"));
+        assert(state["log"][3] == std::string("late"));
+        assert(state["log"].length() == 3);
+        assert(scheduler.size() == 0);
+        state.checkMemLeaks();
+    }
+    
+    // Errors are thrown after whole batch is resumed
+    {
+        lua::State state;
+        lua::CoroutineScheduler scheduler(state);
+        
+        state.doString(R"(
+            count = 0
+            function failing() yield() error('failed') end
+            function counting() yield() count = count + 1 end
+        )");
+        
+        scheduler.spawn(state["failing"]);
+        scheduler.spawn(state["counting"]);
+        try {
+            scheduler.tick();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        assert(state["count"] == 1);
+        assert(scheduler.size() == 0);
+        
+        // Functions can be used only in coroutines of scheduler
+        try {
+            state.doString("sleep(1)");
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        state.checkMemLeaks();
+    }
+    
+    return 0;
+}
@@ -0,0 +1,192 @@
+//
+//  timeslice_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaTimeSlicer.h"
+
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Long script is preempted, short scripts finish first
+    {
+        lua::State state;
+        state.doString(R"(
+            function long()
+                local sum = 0
+                for i = 1, 1000000 do sum = sum + i end
+                return sum
+            end
+            function short(value)
+                return function() return value * 2 end
+            end
+        )");
+        
+        lua::TimeSlicer slicer(state, 1000);
+        std::vector<uint64_t> finished;
+        double longResult = 0;
+        
+        uint64_t longId = slicer.submit(state["long"], [&](uint64_t id, const lua::Value& result) {
+            finished.push_back(id);
+            longResult = result;
+        });
+        
+        int shortSum = 0;
+        for (int i = 1; i <= 3; ++i) {
+            lua::Value function = state["short"](i);
+            slicer.submit(function, [&](uint64_t id, const lua::Value& result) {
+                finished.push_back(id);
+                shortSum += result.toInt();
+            });
+        }
+        assert(slicer.size() == 4);
+        
+        slicer.run();
+        assert(slicer.size() == 0);
+        assert(finished.size() == 4);
+        assert(finished.back() == longId);
+        assert(longResult == 500000500000.0);
+        assert(shortSum == 12);
+        assert(slicer.preemptions() > 100);
+        assert(slicer.slices() == slicer.preemptions() + 4);
+        state.checkMemLeaks();
+    }
+    
+    // Coroutines of script and protected calls are not broken by preemption
+    {
+        lua::State state;
+        state.doString(R"(
+            function nested()
+                local generator = coroutine.wrap(function()
+                    for i = 1, 20000 do coroutine.yield(i) end
+                end)
+                local sum = 0
+                for i = 1, 20000 do sum = sum + generator() end
+                
+                local success, value = pcall(function()
+                    local x = 0
+                    for i = 1, 100000 do x = x + 1 end
+                    return x
+                end)
+                return sum + value
+            end
+        )");
+        
+        lua::TimeSlicer slicer(state, 100);
+        int result = 0;
+        slicer.submit(state["nested"], [&](uint64_t id, const lua::Value& value) {
+            result = value;
+        });
+        slicer.run();
+        assert(result == 20000 * 20001 / 2 + 100000);
+        state.checkMemLeaks();
+    }
+    
+    // Metamethods and iterators of generic for are not broken by preemption
+    {
+        lua::State state;
+        state.doString(R"(
+            function iterating()
+                local function iter(_, i)
+                    for k = 1, 20000 do end
+                    if i < 20 then return i + 1 end
+                end
+                local count = 0
+                for i in iter, nil, 0 do
+                    for k = 1, 20000 do end
+                    count = count + 1
+                end
+                return count
+            end
+            function indexing()
+                local object = setmetatable({}, {__index = function()
+                    for i = 1, 200000 do end
+                    return 5
+                end})
+                return object.x
+            end
+        )");
+        
+        lua::TimeSlicer slicer(state, 1000);
+        int iterated = 0;
+        int indexed = 0;
+        slicer.submit(state["iterating"], [&](uint64_t id, const lua::Value& value) {
+            iterated = value;
+        });
+        slicer.submit(state["indexing"], [&](uint64_t id, const lua::Value& value) {
+            indexed = value;
+        });
+        slicer.run();
+        assert(iterated == 20);
+        assert(indexed == 5);
+        assert(slicer.preemptions() > 0);
+        state.checkMemLeaks();
+    }
+    
+    // Execution limits apply to each slice and stop slice which can't be preempted
+    {
+        lua::State state;
+        state.doString(R"(
+            function spinning()
+                return setmetatable({}, {__index = function() while true do end end}).x
+            end
+            function counting()
+                local count = 0
+                for i = 1, 100000 do count = count + 1 end
+                return count
+            end
+        )");
+        state.setExecutionLimits(50000);
+        
+        lua::TimeSlicer slicer(state, 1000);
+        slicer.submit(state["spinning"]);
+        try {
+            slicer.run();
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+        }
+        
+        int count = 0;
+        slicer.submit(state["counting"], [&](uint64_t id, const lua::Value& value) {
+            count = value;
+        });
+        slicer.run();
+        assert(count == 100000);
+        state.checkMemLeaks();
+    }
+    
+    // Errors are thrown and scripts can be canceled
+    {
+        lua::State state;
+        state.doString(R"(
+            count = 0
+            function failing() for i = 1, 100000 do end error('failed') end
+            function counting() for i = 1, 100000 do count = count + 1 end end
+        )");
+        
+        lua::TimeSlicer slicer(state, 1000);
+        slicer.submit(state["failing"]);
+        slicer.submit(state["counting"]);
+        uint64_t canceled = slicer.submit(state["counting"]);
+        
+        assert(slicer.runSlice());
+        assert(slicer.cancel(canceled));
+        try {
+            slicer.run();
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        slicer.run();
+        assert(state["count"] == 100000);
+        assert(!slicer.runSlice());
+        state.checkMemLeaks();
+    }
+    
+    return 0;
+}
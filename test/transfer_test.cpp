@@ -0,0 +1,115 @@
+//
+//  transfer_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+#include "../include/LuaTransfer.h"
+
+#include <stdexcept>
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+static const char* createTables = R"(
+
+config = {
+    name = 'pipeline',
+    enabled = true,
+    ratio = 0.25,
+    stages = { 'parse', 'filter', 'store' },
+    limits = { memory = 1024, [10] = 'ten', [true] = 'yes' },
+    nested = { deeper = { deepest = { value = 42 } } },
+}
+config.self = config
+config.alias = config.limits
+config.nested.parent = config
+config.binary = 'a\0b'
+
+)";
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Primitives are copied
+    {
+        lua::State source;
+        lua::State destination;
+
+        source.doString("number = 12.5 text = 'hello' flag = true");
+
+        assert(lua::transfer(source["number"], destination) == 12.5);
+        assert(lua::transfer(source["text"], destination) == std::string("hello"));
+        assert(lua::transfer(source["flag"], destination) == true);
+        assert(lua::transfer(source["missing"], destination).is<lua::Nil>());
+
+        source.checkMemLeaks();
+        destination.checkMemLeaks();
+    }
+
+    // Tables are copied deeply with shared and cyclic references
+    {
+        lua::State source;
+        lua::State destination;
+        source.doString(createTables);
+
+        destination.set("config", lua::transfer(source["config"], destination));
+
+        bool valid = destination.doString(R"(
+            return config.name == 'pipeline' and config.enabled and config.ratio == 0.25
+                and #config.stages == 3 and config.stages[3] == 'store'
+                and config.limits.memory == 1024 and config.limits[10] == 'ten' and config.limits[true] == 'yes'
+                and config.nested.deeper.deepest.value == 42
+                and config.self == config and config.alias == config.limits and config.nested.parent == config
+                and config.binary == 'a\0b' and #config.binary == 3
+        )");
+        assert(valid);
+
+        // Copy is independent from source
+        destination.doString("config.name = 'changed'");
+        assert(source["config"]["name"] == std::string("pipeline"));
+
+        source.checkMemLeaks();
+        destination.checkMemLeaks();
+    }
+
+    // C functions without upvalues are copied, Lua functions are not
+    {
+        lua::State source;
+        lua::State destination;
+
+        bool thrown = false;
+        try {
+            source.doString("values = { 1, 2, function() end }");
+            lua::transfer(source["values"], destination);
+        } catch (lua::TypeMismatchError ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        std::string upper = lua::transfer(source["string"]["upper"], destination)("abc");
+        assert(upper == "ABC");
+
+        source.checkMemLeaks();
+        destination.checkMemLeaks();
+    }
+
+    // Too deep nesting is refused
+    {
+        lua::State source;
+        lua::State destination;
+        source.doString("deep = {} local t = deep for i = 1, 1000 do t.next = {} t = t.next end");
+
+        bool thrown = false;
+        try {
+            lua::transfer(source["deep"], destination);
+        } catch (std::overflow_error ex) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        source.checkMemLeaks();
+        destination.checkMemLeaks();
+    }
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+//
+//  watchdog_test.cpp
+//  LuaState
+//
+//  See LICENSE and README.md files
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    // Instruction budget stops runaway script
+    {
+        lua::State state;
+        state.setExecutionLimits(100000, 0, 100);
+        
+        try {
+            state.doString("while true do end");
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+            assert(std::string(ex.what()).find("instruction budget") != std::string::npos);
+        }
+        
+        // Budget is counted for every call
+        state.doString("function work(count) local x = 0 for i = 1, count do x = x + i end return x end");
+        for (int i = 0; i < 10; ++i) {
+            int result = state["work"].call(1000);
+            assert(result == 500500);
+        }
+        
+        try {
+            state["work"].call(1000000);
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+        }
+        
+        // Other errors are not timeouts
+        try {
+            state.doString("error('failed')");
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+            assert(false);
+        }
+        catch (lua::RuntimeError ex) {
+        }
+        state.checkMemLeaks();
+    }
+    
+    // Script can't escape budget with pcall
+    {
+        lua::State state;
+        state.setExecutionLimits(100000, 0, 100);
+        
+        try {
+            state.doString("while true do pcall(function() while true do end end) end");
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+        }
+        state.checkMemLeaks();
+    }
+    
+    // Wall clock budget
+    {
+        lua::State state;
+        state.setExecutionLimits(0, 0.05);
+        
+        auto start = std::chrono::steady_clock::now();
+        try {
+            state.doString("while true do end");
+            assert(false);
+        }
+        catch (lua::RuntimeError& ex) {
+            assert(dynamic_cast<lua::TimeoutError*>(&ex) != nullptr);
+            assert(std::string(ex.what()).find("time budget") != std::string::npos);
+        }
+        assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        
+        // Limits can be removed
+        state.clearExecutionLimits();
+        state.doString("for i = 1, 1000000 do end");
+        state.checkMemLeaks();
+    }
+    
+    // Nested calls from C++ functions share budget of outer call
+    {
+        lua::State state;
+        state.doString("function spin(count) for i = 1, count do end end");
+        lua_State* luaState = state.getState();
+        
+        // Same as unprotected call of lua::Value, but values would leak when timeout error jumps over lambda
+        state.set("callSpin", [luaState](int count) {
+            lua::detail::WatchdogScope watchdogScope(luaState);
+            lua_getglobal(luaState, "spin");
+            lua_pushinteger(luaState, count);
+            lua_call(luaState, 1, 0);
+        });
+        state.setExecutionLimits(500000, 0, 100);
+        
+        state.doString("callSpin(100000) callSpin(100000)");
+        try {
+            state.doString("for i = 1, 10 do callSpin(100000) end");
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+        }
+        
+        // Budget starts again after nested call timed out
+        state.doString("callSpin(100000)");
+        state.doString("for i = 1, 3 do callSpin(100000) end");
+        state.checkMemLeaks();
+    }
+    
+    // Bound functions use protected calls of values and catch timeout, outer call then times out too
+    {
+        lua::State state;
+        state.doString("function spin(count) for i = 1, count do end end");
+        int timeouts = 0;
+        state.set("callSpin", [&state, &timeouts](int count) {
+            try {
+                state["spin"].call(count);
+            }
+            catch (lua::TimeoutError ex) {
+                ++timeouts;
+            }
+        });
+        state.setExecutionLimits(500000, 0, 100);
+        
+        try {
+            state.doString("for i = 1, 10 do callSpin(100000) end");
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+        }
+        assert(timeouts == 1);
+        
+        state.doString("for i = 1, 3 do callSpin(100000) end");
+        assert(timeouts == 1);
+        state.checkMemLeaks();
+    }
+    
+    // Coroutines are limited too
+    {
+        lua::State state;
+        state.setExecutionLimits(100000, 0, 100);
+        state.doString("function loop() coroutine.yield(1) while true do end end");
+        
+        lua::Coroutine coroutine(state["loop"]);
+        assert(coroutine.resume() == 1);
+        try {
+            coroutine.resume();
+            assert(false);
+        }
+        catch (lua::TimeoutError ex) {
+        }
+        state.checkMemLeaks();
+    }
+    
+    return 0;
+}